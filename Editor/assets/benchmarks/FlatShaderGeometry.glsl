@@ -0,0 +1,66 @@
+// FlatShader computing the face normals in a geometry shader instead of from derivatives.
+// Not loaded by the editor, kept as the reference for Benchmarks::FlatShading.
+
+#type vertex
+#version 460 core
+
+#include "../shaders/include/FlatShaderVertex.glsl"
+
+
+#type geometry
+#version 460 core
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec4 v_WorldPosition[];
+in flat int v_EntityID[];
+in vec4 v_Color[];
+
+out vec3 g_WorldPosition;
+out vec3 g_Normal;
+out flat int g_EntityID;
+out vec4 g_Color;
+
+void main()
+{
+    int n;
+    vec3 p0 = v_WorldPosition[0].xyz;
+    vec3 p1 = v_WorldPosition[1].xyz;
+    vec3 p2 = v_WorldPosition[2].xyz;
+    vec3 normal = normalize(cross(p1 - p0, p2 - p0));
+
+    for (n = 0; n < gl_in.length(); n++) {
+        gl_Position = gl_in[n].gl_Position;
+        g_WorldPosition = v_WorldPosition[n].xyz;
+        g_Normal = normal;
+        g_EntityID = v_EntityID[n];
+        g_Color = v_Color[n];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+
+
+#type fragment
+#version 460 core
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out int color2; // -1 no entity
+
+in vec3 g_WorldPosition;
+in vec3 g_Normal;
+in flat int g_EntityID;
+in vec4 g_Color;
+
+uniform vec4 u_Color;
+
+#include "../shaders/include/ClusteredLighting.glsl"
+
+void main() {
+    float flatShade = FlatShade(g_WorldPosition, g_Normal);
+
+    vec4 baseColor = u_Color * g_Color;
+    color = vec4(baseColor.rgb * flatShade, baseColor.a);
+    color2 = g_EntityID;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+// Resolves Weighted Blended OIT accumulation targets over the opaque image
+// Drawn as a single full-screen triangle, expects blending with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+
+#type vertex
+#version 450 core
+
+void main() {
+    // (-1,-1), (3,-1), (-1,3) covers the screen
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+
+
+#type fragment
+#version 450 core
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out int color2; // -1 no entity
+
+uniform sampler2D u_Accumulation;
+uniform sampler2D u_Revealage;
+uniform isampler2D u_EntityIDs;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(u_Revealage, texel, 0).r;
+    // no transparent surface covers this pixel, keep opaque color and entity
+    if (revealage >= 1.0)
+        discard;
+
+    vec4 accumulation = texelFetch(u_Accumulation, texel, 0);
+    vec3 averageColor = accumulation.rgb / max(accumulation.a, 1e-5);
+    color = vec4(averageColor, 1.0 - revealage);
+    color2 = texelFetch(u_EntityIDs, texel, 0).r;
+}
@@ -5,17 +5,29 @@
 
 layout(location = 0) in vec3 a_Position;
 layout(location = 1) in int a_EntityID;
+layout(location = 2) in vec4 a_Color; // per-vertex tint, white when the vertex array has no color attribute
+// The INSTANCED variant takes transform, entity ID and color from per-instance attributes
+#ifdef INSTANCED
+layout(location = 3) in mat4 a_Transform; // per instance, replaces u_Transform
+#endif
 
-uniform mat4 u_ViewProjection;
+#include "include/Camera.glsl"
 uniform mat4 u_Transform;
 
 out vec3 v_Position;
 out flat int v_EntityID;
+out vec4 v_Color;
 
 void main() {
     v_Position = a_Position;
     v_EntityID = a_EntityID;
-    gl_Position = u_ViewProjection * u_Transform * vec4(a_Position, 1.0);
+    v_Color = a_Color;
+#ifdef INSTANCED
+    mat4 transform = a_Transform;
+#else
+    mat4 transform = u_Transform;
+#endif
+    gl_Position = u_ViewProjection * transform * vec4(a_Position, 1.0);
 }
 
 
@@ -27,10 +39,11 @@ layout(location = 1) out int color2; // -1 no entity
 
 in vec3 v_Position;
 in flat int v_EntityID;
+in vec4 v_Color;
 
 uniform vec4 u_Color;
 
 void main() {
-    color = u_Color;
+    color = u_Color * v_Color;
     color2 = v_EntityID;
 }
\ No newline at end of file
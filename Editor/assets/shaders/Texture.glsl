@@ -6,7 +6,7 @@
 layout(location = 0) in vec3 a_Position;
 layout(location = 1) in vec2 a_TexCoord;
 
-uniform mat4 u_ViewProjection;
+#include "include/Camera.glsl"
 uniform mat4 u_Transform;
 
 out vec2 v_TexCoord;
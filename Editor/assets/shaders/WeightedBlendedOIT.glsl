@@ -0,0 +1,62 @@
+// Accumulation pass of Weighted Blended Order-Independent Transparency (McGuire and Bavoil, 2013)
+// Transparent triangles can be drawn in any order. OITComposite.glsl resolves the result.
+
+#type vertex
+#version 450 core
+
+layout(location = 0) in vec3 a_Position;
+layout(location = 1) in int a_EntityID;
+layout(location = 2) in vec4 a_Color;
+
+#include "include/Camera.glsl"
+uniform mat4 u_Transform;
+
+out vec4 v_WorldPosition;
+out flat int v_EntityID;
+out vec4 v_Color;
+
+void main() {
+    v_WorldPosition = u_Transform * vec4(a_Position, 1.0);
+    v_EntityID = a_EntityID;
+    v_Color = a_Color;
+    gl_Position = u_ViewProjection * v_WorldPosition;
+}
+
+
+#type fragment
+#version 450 core
+
+layout(location = 0) out vec4 accumulation; // premultiplied color and alpha, weighted
+layout(location = 1) out float revealage; // blended with (0, 1 - alpha), product of (1 - alpha)s
+layout(location = 2) out int entityID; // of the nearest surface, written in a separate depth-tested pass
+
+in vec4 v_WorldPosition;
+in flat int v_EntityID;
+in vec4 v_Color;
+
+uniform vec4 u_Color;
+uniform int u_IsFlatShaded;
+
+#include "include/ClusteredLighting.glsl"
+
+void main() {
+    vec4 baseColor = u_Color * v_Color;
+    vec3 shadedColor = baseColor.rgb;
+    if (u_IsFlatShaded != 0) {
+        // face normal from the derivatives of the position, flipped for back faces, see FlatShader.glsl
+        vec3 worldPosition = v_WorldPosition.xyz;
+        vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+        if (!gl_FrontFacing) {
+            normal = -normal;
+        }
+        shadedColor *= FlatShade(worldPosition, normal);
+    }
+    float alpha = baseColor.a;
+
+    // Depth weight, equation (10) of the paper. Closer surfaces contribute more.
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+
+    accumulation = vec4(shadedColor * alpha, alpha) * weight;
+    revealage = alpha;
+    entityID = v_EntityID;
+}
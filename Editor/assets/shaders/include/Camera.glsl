@@ -0,0 +1,7 @@
+// Camera uniform block, included by every stage that projects world positions.
+
+// per-frame, written by Renderer::BeginScene
+layout(std140, binding = 0) uniform Camera {
+    mat4 u_ViewProjection;
+    vec4 u_CameraPosition; // w unused
+};
@@ -0,0 +1,47 @@
+// Clustered point lights of a fragment stage, included by the flat shaded shaders.
+// Lights are assigned to the clusters of a grid over the view frustum, see LightClusters.h
+
+#include "Camera.glsl"
+layout(std140, binding = 1) uniform Lights {
+    vec4 u_ViewDepth; // dot(u_ViewDepth, vec4(position, 1.0)) is the view depth of a world position
+    vec4 u_ClusterDepth; // x near depth and y scale of the exponential depth slices
+    uvec4 u_ClusterCount; // tiles across x and y, depth slices
+};
+
+struct PointLight {
+    vec4 position; // xyz position, w intensity
+    float range; // 0 for unlimited
+};
+layout(std430, binding = 2) readonly buffer PointLights {
+    PointLight u_PointLights[];
+};
+layout(std430, binding = 3) readonly buffer LightClusters {
+    uvec2 u_LightClusters[]; // offset into u_ClusterLightIndices and light count
+};
+layout(std430, binding = 4) readonly buffer ClusterLightIndices {
+    uint u_ClusterLightIndices[];
+};
+
+// Sum of the flat shading of the lights of the cluster the position is in
+float FlatShade(vec3 worldPosition, vec3 normal) {
+    vec4 clipPosition = u_ViewProjection * vec4(worldPosition, 1.0);
+    vec2 tile = clamp((clipPosition.xy / clipPosition.w * 0.5 + 0.5) * vec2(u_ClusterCount.xy), vec2(0.0), vec2(u_ClusterCount.xy) - 1.0);
+    float depth = dot(u_ViewDepth, vec4(worldPosition, 1.0));
+    float slice = clamp(log(max(depth, u_ClusterDepth.x) / u_ClusterDepth.x) * u_ClusterDepth.y, 0.0, float(u_ClusterCount.z) - 1.0);
+    uvec2 cluster = u_LightClusters[(uint(slice) * u_ClusterCount.y + uint(tile.y)) * u_ClusterCount.x + uint(tile.x)];
+
+    float flatShade = 0.0;
+    for (uint i = cluster.x; i < cluster.x + cluster.y; i++) {
+        PointLight light = u_PointLights[u_ClusterLightIndices[i]];
+        vec3 toLight = light.position.xyz - worldPosition;
+        float attenuation = 1.0;
+        if (light.range > 0.0) {
+            // smooth window reaching 0 at the range, so that lights end at their clusters' bounds
+            float distanceRatio = dot(toLight, toLight) / (light.range * light.range);
+            attenuation = clamp(1.0 - distanceRatio * distanceRatio, 0.0, 1.0);
+            attenuation *= attenuation;
+        }
+        flatShade += clamp(dot(normalize(toLight), normal) * light.position.w, 0.0, 1.0) * attenuation;
+    }
+    return flatShade;
+}
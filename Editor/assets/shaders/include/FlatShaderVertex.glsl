@@ -0,0 +1,28 @@
+// Vertex stage of the flat shaded shaders, which differ only in how the fragments get their face normals.
+
+layout(location = 0) in vec3 a_Position;
+layout(location = 1) in int a_EntityID;
+layout(location = 2) in vec4 a_Color; // per-vertex tint, white when the vertex array has no color attribute
+// The INSTANCED variant takes transform, entity ID and color from per-instance attributes
+#ifdef INSTANCED
+layout(location = 3) in mat4 a_Transform; // per instance, replaces u_Transform
+#endif
+
+#include "Camera.glsl"
+uniform mat4 u_Transform;
+
+out vec4 v_WorldPosition;
+out flat int v_EntityID;
+out vec4 v_Color;
+
+void main() {
+#ifdef INSTANCED
+    mat4 transform = a_Transform;
+#else
+    mat4 transform = u_Transform;
+#endif
+    v_WorldPosition = transform * vec4(a_Position, 1.0);
+    v_EntityID = a_EntityID;
+    v_Color = a_Color;
+    gl_Position = u_ViewProjection * v_WorldPosition;
+}
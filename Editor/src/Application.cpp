@@ -82,6 +82,13 @@ void Application::RegisterWindowListener(WindowListener* listener) {
 int Application::Run() {
     Renderer::Init();
     RenderCommand::PrintInfo();
+    if (!ShaderCompiler::Instance().IsParallel()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        shaderCompileWindow = glfwCreateWindow(1, 1, "Shader Compiler", NULL, window);
+        glfwDefaultWindowHints();
+        GLFWwindow* compileWindow = shaderCompileWindow;
+        ShaderCompiler::Instance().StartWorker([compileWindow](bool isCurrent) { glfwMakeContextCurrent(isCurrent ? compileWindow : NULL); });
+    }
     ImGuiLayer::Init(window);
 
     int w, h;
@@ -193,6 +200,9 @@ int Application::Run() {
 
     OnShutdown();
     ImGuiLayer::Shutdown();
+    ShaderCompiler::Instance().Shutdown();
+    if (shaderCompileWindow)
+        glfwDestroyWindow(shaderCompileWindow);
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
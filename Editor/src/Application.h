@@ -50,6 +50,7 @@ private:
 private:
 	static Application* instance;
 	float lastFrameTime = 0.0f;
+	GLFWwindow* shaderCompileWindow = nullptr; // hidden, its context compiles shaders when the driver cannot in parallel
 	std::vector<KeyListener*> keyListeners;
 	std::vector<MouseButtonListener*> mouseButtonListeners;
 	std::vector<ScrollListener*> scrollListeners;
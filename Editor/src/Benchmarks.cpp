@@ -0,0 +1,446 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+#include "Math.h"
+#include "Scene/Components.h"
+#include "Renderer/Framebuffer.h"
+#include "Renderer/OcclusionBuffer.h"
+#include "Renderer/Renderer.h"
+#include "Renderer/TransparencySorter.h"
+
+namespace {
+	// Average duration of a call to func in milliseconds
+	static double TimeMilliseconds(int numRepeats, const std::function<void(int)>& func) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < numRepeats; i++)
+			func(i);
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / numRepeats;
+	}
+
+	static bool LoadMesh(const std::string& path, std::vector<MeshComponent::MeshVertex>& vertices, std::vector<glm::uvec3>& indices) {
+		MeshObjLoaderComponent loader;
+		return loader.ReadObjFile(path, vertices, indices);
+	}
+
+	// Vertex array of the mesh with entity ID 1, and its bounds. nullptr if the mesh does not load.
+	static std::shared_ptr<VertexArray> LoadMeshVertexArray(const std::string& path, glm::vec3& min, glm::vec3& max, size_t& triangleCount) {
+		std::vector<MeshComponent::MeshVertex> vertices;
+		std::vector<glm::uvec3> indices;
+		if (!LoadMesh(path, vertices, indices)) return nullptr;
+		for (auto& v : vertices) { v.EntityID = 1; }
+		auto vertexBuffer = std::make_shared<VertexBuffer>(&vertices[0].Position.x, (uint32_t)(sizeof(MeshComponent::MeshVertex) * vertices.size()));
+		vertexBuffer->SetLayout({
+			{ ShaderDataType::Float3, "a_Position" },
+			{ ShaderDataType::Int, "a_EntityID" },
+		});
+		auto vertexArray = std::make_shared<VertexArray>();
+		vertexArray->AddVertexBuffer(vertexBuffer);
+		vertexArray->SetIndexBuffer(std::make_shared<IndexBuffer>(&indices[0].x, (uint32_t)(3 * indices.size())));
+
+		min = vertices[0].Position;
+		max = min;
+		for (const auto& v : vertices) {
+			min = glm::min(min, v.Position);
+			max = glm::max(max, v.Position);
+		}
+		triangleCount = indices.size();
+		return vertexArray;
+	}
+}
+
+namespace Benchmarks {
+	void TransparentSort() {
+		const std::vector<std::string> meshes = {
+			"assets/meshes/teapot-4k.obj",
+			"assets/meshes/teapot-11k.obj",
+			"assets/meshes/bunny.obj",
+		};
+		const int numCopiesOptions[] = { 1, 10 }; // copies of the mesh side by side, as separate transparent objects
+		const int numFrames = 30;
+		const glm::vec3 cameraStart = { 0.0f, 1.0f, 8.0f };
+		const glm::vec3 cameraStep = { 0.01f, 0.0f, 0.0f }; // per frame, small enough for the coherent sort
+
+		std::printf("Transparent Sort Benchmark (average of %d frames, milliseconds)\n", numFrames);
+		std::printf("%-32s %10s %12s %12s %12s %12s\n", "Mesh", "Triangles", "OldPath", "StdSort", "Radix", "Coherent");
+
+		for (const std::string& path : meshes) {
+			std::vector<MeshComponent::MeshVertex> meshVertices;
+			std::vector<glm::uvec3> meshIndices;
+			if (!LoadMesh(path, meshVertices, meshIndices)) continue;
+
+			for (int numCopies : numCopiesOptions) {
+				std::vector<glm::vec3> positions;
+				std::vector<glm::uvec3> triangles;
+				for (int c = 0; c < numCopies; c++) {
+					uint32_t baseVertex = (uint32_t)positions.size();
+					for (auto& v : meshVertices)
+						positions.push_back(v.Position + glm::vec3{ 2.5f * c, 0.0f, 0.0f });
+					for (auto& t : meshIndices)
+						triangles.push_back(t + glm::uvec3(baseVertex));
+				}
+
+				std::vector<float> distances(triangles.size());
+				auto computeDistances = [&](const glm::vec3& cameraPosition) {
+					for (size_t i = 0; i < triangles.size(); i++) {
+						float minDist = 1000000.0f;
+						for (int j = 0; j < 3; j++)
+							minDist = std::min(minDist, glm::length(positions[triangles[i][j]] - cameraPosition));
+						distances[i] = minDist;
+					}
+				};
+
+				// Mimics the struct that was sorted per frame before the TransparencySorter
+				struct TriangleParams {
+					void* mesh;
+					void* meshRenderer;
+					std::shared_ptr<int> shader;
+					void* transform;
+					uint32_t triangleNo;
+					float dist;
+				};
+				auto shader = std::make_shared<int>(0);
+				double oldPath = TimeMilliseconds(numFrames, [&](int frame) {
+					computeDistances(cameraStart + cameraStep * (float)frame);
+					std::vector<TriangleParams> params;
+					for (uint32_t i = 0; i < distances.size(); i++)
+						params.push_back({ nullptr, nullptr, shader, nullptr, i, distances[i] });
+					std::sort(params.rbegin(), params.rend(), [](const TriangleParams& tp1, const TriangleParams& tp2) { return tp1.dist < tp2.dist; });
+				});
+				double distanceTime = TimeMilliseconds(numFrames, [&](int frame) { computeDistances(cameraStart + cameraStep * (float)frame); });
+
+				auto timeSorter = [&](TransparencySorter::Method method) {
+					TransparencySorter sorter;
+					sorter.method = method;
+					computeDistances(cameraStart - cameraStep);
+					sorter.Sort(distances, cameraStart - cameraStep); // warm-up, gives coherent mode a previous frame
+					return TimeMilliseconds(numFrames, [&](int frame) {
+						glm::vec3 cameraPosition = cameraStart + cameraStep * (float)frame;
+						computeDistances(cameraPosition);
+						sorter.Sort(distances, cameraPosition);
+					});
+				};
+				double stdSort = timeSorter(TransparencySorter::Method::StdSort);
+				double radix = timeSorter(TransparencySorter::Method::RadixSort);
+				double coherent = timeSorter(TransparencySorter::Method::CoherentRadixSort);
+
+				// report sorting cost only, distance computation is common to all methods
+				std::string name = std::filesystem::path(path).filename().string() + " x" + std::to_string(numCopies);
+				std::printf("%-32s %10zu %12.3f %12.3f %12.3f %12.3f\n", name.c_str(), triangles.size(),
+					oldPath - distanceTime, stdSort - distanceTime, radix - distanceTime, coherent - distanceTime);
+			}
+		}
+		std::fflush(stdout);
+	}
+
+	void MathKernels() {
+		const size_t count = 100000;
+		const int numRepeats = 20;
+
+		// deterministic pseudo-random inputs
+		uint32_t seed = 12345;
+		auto random = [&seed](float min, float max) {
+			seed = seed * 1664525u + 1013904223u;
+			return min + (max - min) * (float)(seed >> 8) / (float)(1u << 24);
+		};
+		Math::TRSArrays trs;
+		trs.Resize(count);
+		std::vector<glm::vec3> translations(count), rotations(count), scales(count);
+		Math::AABBArrays boxes;
+		boxes.Resize(count);
+		std::vector<float> x(count), y(count), z(count);
+		for (size_t i = 0; i < count; i++) {
+			translations[i] = { random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(-10.0f, 10.0f) };
+			rotations[i] = { random(-3.2f, 3.2f), random(-3.2f, 3.2f), random(-3.2f, 3.2f) };
+			scales[i] = { random(0.1f, 2.0f), random(0.1f, 2.0f), random(0.1f, 2.0f) };
+			trs.Set(i, translations[i], rotations[i], scales[i]);
+			glm::vec3 min = { random(-1.0f, 0.0f), random(-1.0f, 0.0f), random(-1.0f, 0.0f) };
+			boxes.Set(i, min, min + glm::vec3{ random(0.1f, 1.0f), random(0.1f, 1.0f), random(0.1f, 1.0f) });
+			x[i] = random(-5.0f, 5.0f);
+			y[i] = random(-5.0f, 5.0f);
+			z[i] = random(-5.0f, 5.0f);
+		}
+		std::vector<glm::mat4> matrices(count);
+		std::vector<float> outX(count), outY(count), outZ(count);
+		std::vector<glm::vec3> outPoints(count);
+		Math::AABBArrays outBoxes;
+		outBoxes.Resize(count);
+		const glm::mat4 matrix = glm::translate(glm::mat4(1.0f), { 1.0f, 2.0f, 3.0f }) * glm::toMat4(glm::quat(glm::vec3{ 0.3f, 0.2f, 0.1f }));
+		const glm::vec3 origin = { 1.0f, 2.0f, 3.0f };
+
+		std::printf("Math Kernels Benchmark (%s, %zu elements, nanoseconds per element)\n", Math::GetSIMDName(), count);
+		std::printf("%-20s %10s %10s %10s\n", "Kernel", "glm", "SoA", "Speedup");
+		auto report = [&](const char* name, double glmMilliseconds, double soaMilliseconds) {
+			std::printf("%-20s %10.2f %10.2f %9.1fx\n", name, glmMilliseconds * 1e6 / count, soaMilliseconds * 1e6 / count, glmMilliseconds / soaMilliseconds);
+		};
+
+		report("ComposeTransforms",
+			TimeMilliseconds(numRepeats, [&](int) {
+				for (size_t i = 0; i < count; i++)
+					matrices[i] = glm::translate(glm::mat4(1.0f), translations[i]) * glm::toMat4(glm::quat(rotations[i])) * glm::scale(glm::mat4(1.0f), scales[i]);
+			}),
+			TimeMilliseconds(numRepeats, [&](int) { Math::ComposeTransforms(trs, matrices.data()); }));
+
+		report("TransformPoints",
+			TimeMilliseconds(numRepeats, [&](int) {
+				for (size_t i = 0; i < count; i++)
+					outPoints[i] = glm::vec3(matrix * glm::vec4{ x[i], y[i], z[i], 1.0f });
+			}),
+			TimeMilliseconds(numRepeats, [&](int) { Math::TransformPoints(matrix, x.data(), y.data(), z.data(), count, outX.data(), outY.data(), outZ.data()); }));
+
+		report("Distances",
+			TimeMilliseconds(numRepeats, [&](int) {
+				for (size_t i = 0; i < count; i++)
+					outX[i] = glm::length(glm::vec3{ x[i], y[i], z[i] } - origin);
+			}),
+			TimeMilliseconds(numRepeats, [&](int) { Math::Distances(x.data(), y.data(), z.data(), count, origin, outX.data()); }));
+
+		// glm version transforms the 8 corners
+		report("TransformAABBs",
+			TimeMilliseconds(numRepeats, [&](int) {
+				for (size_t i = 0; i < count; i++) {
+					glm::vec3 min{ std::numeric_limits<float>::max() }, max{ std::numeric_limits<float>::lowest() };
+					for (int corner = 0; corner < 8; corner++) {
+						glm::vec3 p = {
+							corner & 1 ? boxes.maxX[i] : boxes.minX[i],
+							corner & 2 ? boxes.maxY[i] : boxes.minY[i],
+							corner & 4 ? boxes.maxZ[i] : boxes.minZ[i] };
+						glm::vec3 world = glm::vec3(matrices[i] * glm::vec4{ p, 1.0f });
+						min = glm::min(min, world);
+						max = glm::max(max, world);
+					}
+					outBoxes.Set(i, min, max);
+				}
+			}),
+			TimeMilliseconds(numRepeats, [&](int) { Math::TransformAABBs(matrices.data(), boxes, outBoxes); }));
+		std::fflush(stdout);
+	}
+
+	void OcclusionCulling() {
+		const uint32_t width = 320;
+		const uint32_t height = 180;
+		const int numRepeats = 20;
+		const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), (float)width / height, 0.1f, 100.0f) *
+			glm::lookAt(glm::vec3{ 0.0f, 0.0f, 10.0f }, glm::vec3{ 0.0f }, { 0.0f, 1.0f, 0.0f });
+		OcclusionBuffer occlusionBuffer;
+		occlusionBuffer.Resize(width, height);
+
+		// A wall facing the camera at z = 0, made of two occluders split at x = 0. Tiles along the split and along the
+		// diagonals of the quads are only fully covered once the working layers merge triangles.
+		const std::vector<glm::vec3> wallPositions = {
+			{ -4.0f, -3.0f, 0.0f }, { 0.0f, -3.0f, 0.0f }, { 0.0f, 3.0f, 0.0f }, { -4.0f, 3.0f, 0.0f },
+			{ 0.0f, -3.0f, 0.0f }, { 4.0f, -3.0f, 0.0f }, { 4.0f, 3.0f, 0.0f }, { 0.0f, 3.0f, 0.0f },
+		};
+		const std::vector<glm::uvec3> wallTriangles = { { 0, 1, 2 }, { 0, 2, 3 }, { 4, 5, 6 }, { 4, 6, 7 } };
+		occlusionBuffer.Begin(viewProjection);
+		occlusionBuffer.AddOccluder(glm::mat4(1.0f), wallPositions.data(), sizeof(glm::vec3), &wallTriangles[0], 2);
+		occlusionBuffer.AddOccluder(glm::mat4(1.0f), wallPositions.data(), sizeof(glm::vec3), &wallTriangles[2], 2);
+		occlusionBuffer.Rasterize();
+
+		struct Case {
+			const char* name;
+			glm::vec3 min, max;
+			bool isVisible;
+		};
+		const Case cases[] = {
+			{ "In front of the wall", { -1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 2.0f }, true },
+			{ "Behind the wall", { -1.0f, -1.0f, -3.0f }, { 1.0f, 1.0f, -2.0f }, false },
+			{ "Behind the split", { -0.5f, -0.5f, -2.0f }, { 0.5f, 0.5f, -1.0f }, false },
+			{ "Behind, sticking out", { 3.0f, -1.0f, -3.0f }, { 6.0f, 1.0f, -2.0f }, true },
+			{ "Through the wall", { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f }, true },
+			{ "Crossing the near plane", { -1.0f, -1.0f, 9.0f }, { 1.0f, 1.0f, 11.0f }, true },
+		};
+		std::printf("Occlusion Culling Check (%ux%u, wall of 2 occluders)\n", occlusionBuffer.GetWidth(), occlusionBuffer.GetHeight());
+		std::printf("%-28s %10s %10s\n", "Box", "Expected", "Result");
+		bool isPassed = true;
+		for (const Case& c : cases) {
+			const bool isVisible = occlusionBuffer.IsVisible(c.min, c.max);
+			std::printf("%-28s %10s %10s\n", c.name, c.isVisible ? "visible" : "occluded", isVisible ? "visible" : "occluded");
+			isPassed &= isVisible == c.isVisible;
+		}
+		assert(isPassed); // OcclusionBuffer disagrees with an expected result above
+
+		// rasterization time of a dense occluder filling most of the view
+		std::vector<MeshComponent::MeshVertex> vertices;
+		std::vector<glm::uvec3> indices;
+		if (!LoadMesh("assets/meshes/bunny.obj", vertices, indices)) return;
+		glm::vec3 min = vertices[0].Position, max = min;
+		for (const auto& v : vertices) {
+			min = glm::min(min, v.Position);
+			max = glm::max(max, v.Position);
+		}
+		const float scale = 8.0f / glm::length(max - min);
+		const glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -(min + max) * 0.5f);
+		const double milliseconds = TimeMilliseconds(numRepeats, [&](int) {
+			occlusionBuffer.Begin(viewProjection);
+			occlusionBuffer.AddOccluder(transform, &vertices[0].Position, sizeof(MeshComponent::MeshVertex), indices.data(), indices.size());
+			occlusionBuffer.Rasterize();
+		});
+		size_t coveredTiles = 0;
+		for (const OcclusionBuffer::Tile& tile : occlusionBuffer.GetTiles()) {
+			coveredTiles += tile.zMax0 < std::numeric_limits<float>::max();
+		}
+		std::printf("Rasterizing bunny.obj: %u triangles, %.3f ms, %zu of %zu tiles covered\n",
+			occlusionBuffer.GetOccluderTriangleCount(), milliseconds, coveredTiles, occlusionBuffer.GetTiles().size());
+		std::fflush(stdout);
+	}
+	void FlatShading() {
+		const std::string path = "assets/meshes/bunny.obj";
+		const uint32_t width = 1280;
+		const uint32_t height = 720;
+		const int numFrames = 50;
+
+		glm::vec3 min, max;
+		size_t triangleCount;
+		auto vertexArray = LoadMeshVertexArray(path, min, max, triangleCount);
+		if (!vertexArray) return;
+
+		// the mesh fills the view, lit from the camera's side
+		const glm::vec3 center = (min + max) * 0.5f;
+		const float radius = glm::length(max - min) * 0.5f;
+		const glm::vec3 eye = center + glm::vec3{ 0.0f, 0.0f, 2.5f * radius };
+		const Camera camera(glm::perspective(glm::radians(45.0f), (float)width / height, 0.01f * radius, 10.0f * radius));
+		const glm::mat4 cameraTransform = glm::inverse(glm::lookAt(eye, center, { 0.0f, 1.0f, 0.0f }));
+		const std::vector<Renderer::LightInfo> lights = { { eye + glm::vec3{ radius, radius, 0.0f }, 1.0f, 0.0f } };
+
+		FramebufferSpecification spec;
+		spec.Attachments = { FramebufferTextureFormat::RGBA8, FramebufferTextureFormat::RED_INTEGER, FramebufferTextureFormat::Depth };
+		spec.Width = width;
+		spec.Height = height;
+		Framebuffer framebuffer(spec);
+
+		auto render = [&](const std::shared_ptr<Shader>& shader, std::vector<uint8_t>& pixels) {
+			Renderer::BeginScene(camera, cameraTransform, lights);
+			framebuffer.Bind();
+			shader->Bind();
+			shader->UploadUniformFloat4("u_Color", glm::vec4(1.0f));
+			auto frame = [&](int) {
+				RenderCommand::Clear();
+				Renderer::Submit(shader, vertexArray);
+				glFinish();
+			};
+			frame(0); // warm-up
+			double milliseconds = TimeMilliseconds(numFrames, frame);
+			pixels.resize(4 * width * height);
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			framebuffer.Unbind();
+			Renderer::EndScene();
+			return milliseconds;
+		};
+
+		std::vector<uint8_t> geometryPixels, derivativePixels;
+		const double geometryMilliseconds = render(std::make_shared<Shader>("assets/benchmarks/FlatShaderGeometry.glsl"), geometryPixels);
+		const double derivativeMilliseconds = render(ShaderLibrary::Instance().Get("FlatShader"), derivativePixels);
+		int numDifferentPixels = 0, maxDifference = 0;
+		for (size_t i = 0; i < geometryPixels.size(); i += 4) {
+			int difference = 0;
+			for (size_t c = 0; c < 4; c++)
+				difference = std::max(difference, std::abs(geometryPixels[i + c] - derivativePixels[i + c]));
+			numDifferentPixels += difference > 0;
+			maxDifference = std::max(maxDifference, difference);
+		}
+
+		std::printf("Flat Shading Benchmark (%s, %zu triangles, %ux%u, average of %d frames, milliseconds)\n", path.c_str(), triangleCount, width, height, numFrames);
+		std::printf("%-20s %10s %10s\n", "Shader", "Frame", "Speedup");
+		std::printf("%-20s %10.3f %10s\n", "GeometryShader", geometryMilliseconds, "");
+		std::printf("%-20s %10.3f %9.1fx\n", "Derivatives", derivativeMilliseconds, geometryMilliseconds / derivativeMilliseconds);
+		std::printf("Images differ in %d of %u pixels, by at most %d\n", numDifferentPixels, width * height, maxDifference);
+		std::fflush(stdout);
+	}
+
+	void ClusteredLighting() {
+		const std::string path = "assets/meshes/bunny.obj";
+		const uint32_t width = 1280;
+		const uint32_t height = 720;
+		const int numFrames = 10;
+		const std::vector<uint32_t> lightCounts = { 16, 256, 1024, 5000 };
+		const uint32_t maxAllLightsCount = 1024; // visiting every light per fragment gets too slow past it
+
+		glm::vec3 min, max;
+		size_t triangleCount;
+		auto vertexArray = LoadMeshVertexArray(path, min, max, triangleCount);
+		if (!vertexArray) return;
+
+		const glm::vec3 center = (min + max) * 0.5f;
+		const float radius = glm::length(max - min) * 0.5f;
+		const glm::vec3 eye = center + glm::vec3{ 0.0f, 0.0f, 2.5f * radius };
+		const Camera camera(glm::perspective(glm::radians(45.0f), (float)width / height, 0.01f * radius, 10.0f * radius));
+		const glm::mat4 cameraTransform = glm::inverse(glm::lookAt(eye, center, { 0.0f, 1.0f, 0.0f }));
+
+		// deterministic pseudo-random lights in a box around the mesh
+		uint32_t seed = 12345;
+		auto random = [&seed](float min, float max) {
+			seed = seed * 1664525u + 1013904223u;
+			return min + (max - min) * (float)(seed >> 8) / (float)(1u << 24);
+		};
+		std::vector<Renderer::LightInfo> allLights(lightCounts.back());
+		for (auto& light : allLights) {
+			light.position = center + glm::vec3{ random(-2.0f, 2.0f), random(-1.5f, 1.5f), random(-2.0f, 2.0f) } * radius;
+			light.intensity = 0.3f;
+			light.range = 0.3f * radius;
+		}
+
+		FramebufferSpecification spec;
+		spec.Attachments = { FramebufferTextureFormat::RGBA8, FramebufferTextureFormat::RED_INTEGER, FramebufferTextureFormat::Depth };
+		spec.Width = width;
+		spec.Height = height;
+		Framebuffer framebuffer(spec);
+		const std::shared_ptr<Shader> shader = ShaderLibrary::Instance().Get("FlatShader");
+
+		// the light assignment is part of a frame, it runs in BeginScene
+		auto render = [&](const std::vector<Renderer::LightInfo>& lights) {
+			framebuffer.Bind();
+			auto frame = [&](int) {
+				Renderer::BeginScene(camera, cameraTransform, lights);
+				RenderCommand::Clear();
+				shader->Bind();
+				shader->UploadUniformFloat4("u_Color", glm::vec4(1.0f));
+				Renderer::Submit(shader, vertexArray);
+				Renderer::EndScene();
+				glFinish();
+			};
+			frame(0); // warm-up
+			double milliseconds = TimeMilliseconds(numFrames, frame);
+			framebuffer.Unbind();
+			return milliseconds;
+		};
+
+		std::printf("Clustered Lighting Benchmark (%s, %zu triangles, %ux%u, %u clusters, average of %d frames, milliseconds)\n",
+			path.c_str(), triangleCount, width, height, LightClusters::ClusterCount, numFrames);
+		std::printf("%-8s %10s %10s %10s %12s %12s\n", "Lights", "Clustered", "Assign", "Occupied", "Lights/Occ.", "All Lights");
+		for (uint32_t lightCount : lightCounts) {
+			std::vector<Renderer::LightInfo> lights(allLights.begin(), allLights.begin() + lightCount);
+			const double clusteredMilliseconds = render(lights);
+			const LightClusters& lightClusters = Renderer::GetLightClusters();
+			const uint32_t occupiedClusters = lightClusters.GetOccupiedClusterCount();
+			const float lightsPerOccupied = occupiedClusters ? (float)lightClusters.GetLightIndices().size() / occupiedClusters : 0.0f;
+			const float assignMilliseconds = lightClusters.GetLastAssignMilliseconds();
+
+			// unlimited lights are in every cluster, as if every fragment looped over every light
+			char allLightsText[32] = "-";
+			if (lightCount <= maxAllLightsCount) {
+				for (auto& light : lights) { light.range = 0.0f; }
+				std::snprintf(allLightsText, sizeof(allLightsText), "%.3f", render(lights));
+			}
+			std::printf("%-8u %10.3f %10.3f %10u %12.1f %12s\n", lightCount, clusteredMilliseconds, assignMilliseconds, occupiedClusters, lightsPerOccupied, allLightsText);
+		}
+		std::fflush(stdout);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Micro benchmarks that can be run from the editor. Results are printed to standard output.
+namespace Benchmarks {
+	// Compares the old per-frame std::sort of heavy triangle structs with the TransparencySorter methods on the shipped meshes
+	void TransparentSort();
+	// Compares Math SoA kernels with per-element glm code, reports time per element and speedup
+	void MathKernels();
+	// Checks OcclusionBuffer against a known wall of occluders, asserting which boxes are hidden behind it,
+	// and times rasterizing bunny.obj as an occluder. CPU only.
+	void OcclusionCulling();
+	// Compares frame time of FlatShader, normals from derivatives, with the geometry shader version on bunny.obj,
+	// and how much their images differ. Needs the GL context.
+	void FlatShading();
+	// Frame time of FlatShader on bunny.obj with up to 5000 ranged lights assigned to clusters, with cluster occupancy,
+	// and with the same lights unlimited so that every fragment visits all of them. Needs the GL context.
+	void ClusteredLighting();
+}
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -11,6 +12,7 @@
 
 #include "Editor.h"
 
+#include "Benchmarks.h"
 #include "Input.h"
 #include "Layers/TriangleExampleLayer.h"
 #include "Math.h"
@@ -37,8 +39,21 @@ void Editor::OnInit() {
     RegisterKeyListener(this);
     RegisterMouseButtonListener(this);
 
+    // cold starts compile every shader, warm starts load the binaries saved by the previous one
+    auto shaderLoadStart = std::chrono::high_resolution_clock::now();
+    ShaderLibrary::Instance().SetBinaryCacheDirectory("shadercache");
     ShaderLibrary::Instance().Load("assets/shaders/SolidColor.glsl");
     ShaderLibrary::Instance().Load("assets/shaders/FlatShader.glsl");
+    ShaderLibrary::Instance().Load("assets/shaders/WeightedBlendedOIT.glsl");
+    ShaderLibrary::Instance().Load("assets/shaders/OITComposite.glsl");
+    // multi-draws need the instanced variants from the first frame on
+    for (const char* name : { "SolidColor", "FlatShader" })
+        ShaderLibrary::Instance().GetVariant(ShaderLibrary::Instance().Get(name), { "INSTANCED" });
+    ShaderLibrary::Instance().WaitForCompiles();
+    auto shaderLoadEnd = std::chrono::high_resolution_clock::now();
+    shaderLoadMilliseconds = std::chrono::duration<float, std::milli>(shaderLoadEnd - shaderLoadStart).count();
+    std::cout << "Shaders loaded in " << shaderLoadMilliseconds << " ms, " << ShaderLibrary::Instance().GetBinaryCacheHitCount()
+        << " from the binary cache, " << ShaderLibrary::Instance().GetBinaryCacheMissCount() << " compiled" << std::endl;
        
     sceneHierarchyPanel.SetContext(activeScene);
 
@@ -102,6 +117,22 @@ void Editor::OnImGuiRender() {
     ImGui::Separator();
     auto& stats = RenderCommand::GetStats();
     ImGui::Text("Draw Calls: %d", stats.drawCalls);
+    ImGui::Text("Shader Binds: %d, Vertex Array Binds: %d", stats.shaderBinds, stats.vertexArrayBinds);
+    ImGui::Text("Redundant State Changes Skipped: %d", stats.redundantStateChanges);
+    ImGui::Text("Shader Variants: %u", ShaderLibrary::Instance().GetVariantCount());
+    ImGui::Text("Shader Reloads: %u (%s), Failed Compiles: %u", ShaderLibrary::Instance().GetReloadCount(),
+        ShaderLibrary::Instance().GetLastReloadedFile().c_str(), ShaderLibrary::Instance().GetFailedCompileCount());
+    ImGui::Text("Shader Startup: %.1f ms, Cached Binaries Loaded: %u / %u", shaderLoadMilliseconds,
+        ShaderLibrary::Instance().GetBinaryCacheHitCount(), ShaderLibrary::Instance().GetBinaryCacheHitCount() + ShaderLibrary::Instance().GetBinaryCacheMissCount());
+    ImGui::Text("Meshes Visible: %d, Culled: %d, Occluded: %d", stats.visibleMeshes, stats.culledMeshes, stats.occludedMeshes);
+    ImGui::Text("Triangles Saved by LOD: %d", stats.trianglesSavedByLOD);
+    ImGui::Text("Multi-Drawn Meshes: %d", stats.multiDrawnMeshes);
+    const LightClusters& lightClusters = Renderer::GetLightClusters();
+    const uint32_t occupiedClusters = lightClusters.GetOccupiedClusterCount();
+    ImGui::Text("Light Clusters Occupied: %u / %u, Lights per Occupied Cluster: %.1f avg, %u max", occupiedClusters, LightClusters::ClusterCount,
+        occupiedClusters ? (float)lightClusters.GetLightIndices().size() / occupiedClusters : 0.0f, lightClusters.GetMaxClusterLightCount());
+    ImGui::Text("Light Assignment: %.3f ms", lightClusters.GetLastAssignMilliseconds());
+    ImGui::Text("Stream Rings: %u / %u KB, Stalls: %d", stats.ringBytes / 1024, stats.ringCapacity / 1024, stats.ringStalls);
     ImGui::Text("Triangles: %d", stats.triangles);
     ImGui::Text("Lines: %d", stats.lines);
 
@@ -116,10 +147,19 @@ void Editor::OnImGuiRender() {
 
     ImGui::Separator();
     ImGui::Text("FPS: %.1f", framesPerSecond);
+    ImGui::Text("Transform updates: %u", activeScene->GetLastTransformUpdateCount());
 
     ImGui::Separator();
     ImGui::Checkbox("Wireframe", &activeScene->renderWireframe);
     ImGui::Checkbox("Only Front Faces", &activeScene->renderOnlyFront);
+    ImGui::Checkbox("Frustum Culling", &activeScene->enableFrustumCulling);
+    ImGui::DragFloat("Min Screen Size", &activeScene->minScreenSize, 0.001f, 0.0f, 1.0f);
+    ImGui::Checkbox("Occlusion Culling", &activeScene->enableOcclusionCulling);
+    ImGui::DragFloat("Min Occluder Size", &activeScene->occluderMinScreenSize, 0.01f, 0.0f, 2.0f);
+    ImGui::Checkbox("LOD", &activeScene->enableLOD);
+    ImGui::DragFloat("LOD Screen Size", &activeScene->lodScreenSize, 0.01f, 0.0f, 2.0f);
+    ImGui::SliderInt("Force LOD", &activeScene->forcedLOD, -1, 6);
+    ImGui::Checkbox("Multi-Draw", &activeScene->enableMultiDraw);
 
     ImGui::Separator();
     if (ImGui::Button("Solid Color", ImVec2{ 100.0, 25.0 }))
@@ -127,6 +167,33 @@ void Editor::OnImGuiRender() {
     if (ImGui::Button("Flat Shading", ImVec2{ 100.0, 25.0 }))
         activeScene->renderFlatShading = true;
 
+    ImGui::Separator();
+    const char* transparencyModeStrings[] = { "Sorted Triangles", "Weighted Blended OIT" };
+    int transparencyMode = (int)activeScene->transparencyMode;
+    if (ImGui::Combo("Transparency", &transparencyMode, transparencyModeStrings, 2))
+        activeScene->transparencyMode = (Renderer::TransparencyMode)transparencyMode;
+    TransparencySorter& sorter = Renderer::GetTransparencySorter();
+    const char* sortMethodStrings[] = { "std::sort", "Radix Sort", "Coherent Radix Sort" };
+    int sortMethod = (int)sorter.method;
+    if (ImGui::Combo("Transparent Sort", &sortMethod, sortMethodStrings, 3))
+        sorter.method = (TransparencySorter::Method)sortMethod;
+    ImGui::Text("Sort: %.3f ms (%s)", sorter.GetLastSortMilliseconds(), sortMethodStrings[(int)sorter.GetLastMethodUsed()]);
+    if (ImGui::Button("Benchmark Transparent Sort")) {
+        Benchmarks::TransparentSort();
+    }
+    if (ImGui::Button("Benchmark Math Kernels")) {
+        Benchmarks::MathKernels();
+    }
+    if (ImGui::Button("Benchmark Occlusion Culling")) {
+        Benchmarks::OcclusionCulling();
+    }
+    if (ImGui::Button("Benchmark Flat Shading")) {
+        Benchmarks::FlatShading();
+    }
+    if (ImGui::Button("Benchmark Clustered Lighting")) {
+        Benchmarks::ClusteredLighting();
+    }
+
     ImGui::Separator();
     if (ImGui::Button("Save Frame's Draw Calls")) {
         RenderCommand::shouldDebugRenderSingleFrame = true;
@@ -157,7 +224,7 @@ void Editor::OnImGuiViewportRender() {
         if (sceneCameraHandle.valid()) {
             const auto& cameraComponent = sceneCameraHandle.get<CameraComponent>();
             cameraProjection = cameraComponent.Camera.GetProjection();
-            cameraView = glm::inverse(sceneCameraHandle.get<TransformComponent>().GetTransform());
+            cameraView = sceneCameraHandle.get<TransformComponent>().GetInverseTransform();
         }
         else { // Editor Camera always exists
             cameraProjection = editorCamera.GetProjection();
@@ -178,14 +245,17 @@ void Editor::OnImGuiViewportRender() {
             gizmoType, ImGuizmo::LOCAL, glm::value_ptr(transform), nullptr, shouldSnap ? snapValues : nullptr);
 
         if (ImGuizmo::IsUsing()) {
+            // gizmo works in world-space, components are relative to the parent
+            glm::mat4 localTransform = glm::inverse(activeScene->GetParentTransform(selectedHandle.entity())) * transform;
             glm::vec3 translation, rotation, scale;
-            Math::DecomposeTransform(transform, translation, rotation, scale);
+            Math::DecomposeTransform(localTransform, translation, rotation, scale);
 
             tc.Translation = translation;
             // To prevent gimble-lock
             glm::vec3 deltaRotation = rotation - tc.Rotation;
             tc.Rotation += deltaRotation;
             tc.Scale = scale;
+            selectedHandle.patch<TransformComponent>();
         }
     }
 }
@@ -196,6 +266,7 @@ void Editor::OnViewportResize(float width, float height) {
 }
 
 void Editor::OnUpdate(Timestep ts) {
+    ShaderLibrary::Instance().Update();
     editorCamera.OnUpdate(ts);
 
     RenderCommand::SetClearColor({ 0.1f, 0.1f, 0.1f, 1.0f });
@@ -209,6 +280,7 @@ void Editor::OnUpdate(Timestep ts) {
         entt::entity selectedEntity = sceneHierarchyPanel.GetSelectedEntity();
         if (selectedEntity != entt::null) {
             glm::vec3& selectedTranslation = activeScene->Reg().get<TransformComponent>(selectedEntity).Translation;
+            const glm::vec3 previousTranslation = selectedTranslation;
             float deltaDistance = entityMoveSpeed * ts;
             if (Input::IsKeyHeld(GLFW_KEY_J))
                 selectedTranslation.x -= deltaDistance;
@@ -218,6 +290,8 @@ void Editor::OnUpdate(Timestep ts) {
                 selectedTranslation.y += deltaDistance;
             else if (Input::IsKeyHeld(GLFW_KEY_K)) 
                 selectedTranslation.y -= deltaDistance;
+            if (selectedTranslation != previousTranslation)
+                activeScene->Reg().patch<TransformComponent>(selectedEntity);
         }
     }
 
@@ -42,6 +42,7 @@ private:
 
 
 	float entityMoveSpeed = 5.0f;
+	float shaderLoadMilliseconds = 0.0f; // at startup
 
 	bool showDemoWindow = false;
 	
@@ -47,6 +47,7 @@ void TriangleExampleLayer::OnInit() {
     quadVertexArray->SetIndexBuffer(squareIB);
 
     auto textureShader = ShaderLibrary::Instance().Load("assets/shaders/Texture.glsl");
+    ShaderLibrary::Instance().WaitForCompiles(); // to set the sampler
     textureShader->Bind();
     textureShader->UploadUniformInt("u_Texture", diffuseTextureSlot);
     textureCheckerboard.reset(new Texture2D("assets/textures/Checkerboard.png"));
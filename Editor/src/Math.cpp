@@ -1,7 +1,125 @@
 #include "Math.h"
 
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATH_USE_SSE2
+#endif
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/matrix_decompose.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Thin wrappers so that each kernel is written once, and instantiated for the widest available type and for single floats for the tail
+namespace {
+	struct Float1 {
+		static constexpr size_t Width = 1;
+		float v;
+
+		static Float1 Load(const float* p) { return { *p }; }
+		static Float1 Set(float x) { return { x }; }
+		// p[0], p[stride], p[2 * stride], ...
+		static Float1 Gather(const float* p, size_t) { return { *p }; }
+		void Store(float* p) const { *p = v; }
+	};
+	inline Float1 operator+(Float1 a, Float1 b) { return { a.v + b.v }; }
+	inline Float1 operator-(Float1 a, Float1 b) { return { a.v - b.v }; }
+	inline Float1 operator*(Float1 a, Float1 b) { return { a.v * b.v }; }
+	inline Float1 operator/(Float1 a, Float1 b) { return { a.v / b.v }; }
+	inline Float1 Min(Float1 a, Float1 b) { return { a.v < b.v ? a.v : b.v }; }
+	inline Float1 Max(Float1 a, Float1 b) { return { a.v > b.v ? a.v : b.v }; }
+	inline Float1 Round(Float1 a) { return { std::nearbyint(a.v) }; }
+	inline Float1 Sqrt(Float1 a) { return { std::sqrt(a.v) }; }
+
+#if defined(__AVX2__)
+	const char* simdName = "AVX2";
+	struct FloatWide {
+		static constexpr size_t Width = 8;
+		__m256 v;
+
+		static FloatWide Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static FloatWide Set(float x) { return { _mm256_set1_ps(x) }; }
+		static FloatWide Gather(const float* p, size_t stride) {
+			const int s = (int)stride;
+			return { _mm256_i32gather_ps(p, _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s), 4) };
+		}
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+	inline FloatWide operator+(FloatWide a, FloatWide b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline FloatWide operator-(FloatWide a, FloatWide b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline FloatWide operator*(FloatWide a, FloatWide b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline FloatWide operator/(FloatWide a, FloatWide b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline FloatWide Min(FloatWide a, FloatWide b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline FloatWide Max(FloatWide a, FloatWide b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline FloatWide Round(FloatWide a) { return { _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+	inline FloatWide Sqrt(FloatWide a) { return { _mm256_sqrt_ps(a.v) }; }
+#elif defined(MATH_USE_SSE2)
+	const char* simdName = "SSE2";
+	struct FloatWide {
+		static constexpr size_t Width = 4;
+		__m128 v;
+
+		static FloatWide Load(const float* p) { return { _mm_loadu_ps(p) }; }
+		static FloatWide Set(float x) { return { _mm_set1_ps(x) }; }
+		static FloatWide Gather(const float* p, size_t stride) { return { _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]) }; }
+		void Store(float* p) const { _mm_storeu_ps(p, v); }
+	};
+	inline FloatWide operator+(FloatWide a, FloatWide b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline FloatWide operator-(FloatWide a, FloatWide b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline FloatWide operator*(FloatWide a, FloatWide b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline FloatWide operator/(FloatWide a, FloatWide b) { return { _mm_div_ps(a.v, b.v) }; }
+	inline FloatWide Min(FloatWide a, FloatWide b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline FloatWide Max(FloatWide a, FloatWide b) { return { _mm_max_ps(a.v, b.v) }; }
+	// SSE2 has no round instruction, conversion rounds to nearest. Fine for the angles used here.
+	inline FloatWide Round(FloatWide a) { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+	inline FloatWide Sqrt(FloatWide a) { return { _mm_sqrt_ps(a.v) }; }
+#else
+	const char* simdName = "Scalar";
+	using FloatWide = Float1;
+#endif
+
+	// Calls kernel(F{}, begin, end) with the widest type for most of [0, count), then with Float1 for the remainder
+	template <typename Kernel>
+	void ForEachBatch(size_t count, const Kernel& kernel) {
+		size_t wideEnd = count - count % FloatWide::Width;
+		kernel(FloatWide{}, (size_t)0, wideEnd);
+		kernel(Float1{}, wideEnd, count);
+	}
+
+	// Polynomial sine and cosine. Reduced to [-pi, pi], absolute error below 1e-6.
+	template <typename F>
+	void SinCos(F x, F& sin, F& cos) {
+		const float twoPiHigh = 6.28125f; // 2 pi split in two for an exact reduction of small multiples
+		const float twoPiLow = 0.0019353071795864769f;
+		F k = Round(x * F::Set(0.15915494309189535f));
+		F y = (x - k * F::Set(twoPiHigh)) - k * F::Set(twoPiLow);
+		F y2 = y * y;
+
+		F s = F::Set(-1.0f / 1307674368000.0f);
+		s = s * y2 + F::Set(1.0f / 6227020800.0f);
+		s = s * y2 + F::Set(-1.0f / 39916800.0f);
+		s = s * y2 + F::Set(1.0f / 362880.0f);
+		s = s * y2 + F::Set(-1.0f / 5040.0f);
+		s = s * y2 + F::Set(1.0f / 120.0f);
+		s = s * y2 + F::Set(-1.0f / 6.0f);
+		s = s * y2 + F::Set(1.0f);
+		sin = s * y;
+
+		F c = F::Set(1.0f / 20922789888000.0f);
+		c = c * y2 + F::Set(-1.0f / 87178291200.0f);
+		c = c * y2 + F::Set(1.0f / 479001600.0f);
+		c = c * y2 + F::Set(-1.0f / 3628800.0f);
+		c = c * y2 + F::Set(1.0f / 40320.0f);
+		c = c * y2 + F::Set(-1.0f / 720.0f);
+		c = c * y2 + F::Set(1.0f / 24.0f);
+		c = c * y2 + F::Set(-1.0f / 2.0f);
+		cos = c * y2 + F::Set(1.0f);
+	}
+}
 
 namespace Math {
 
@@ -63,4 +181,190 @@ namespace Math {
 		return true;
 	}
 
-}
\ No newline at end of file
+	const char* GetSIMDName() {
+		return simdName;
+	}
+
+	void TRSArrays::Resize(size_t count) {
+		for (auto* array : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ })
+			array->resize(count);
+	}
+
+	void TRSArrays::Set(size_t index, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+		translationX[index] = translation.x; translationY[index] = translation.y; translationZ[index] = translation.z;
+		rotationX[index] = rotation.x; rotationY[index] = rotation.y; rotationZ[index] = rotation.z;
+		scaleX[index] = scale.x; scaleY[index] = scale.y; scaleZ[index] = scale.z;
+	}
+
+	void AABBArrays::Resize(size_t count) {
+		for (auto* array : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+			array->resize(count);
+	}
+
+	void AABBArrays::Set(size_t index, const glm::vec3& min, const glm::vec3& max) {
+		minX[index] = min.x; minY[index] = min.y; minZ[index] = min.z;
+		maxX[index] = max.x; maxY[index] = max.y; maxZ[index] = max.z;
+	}
+
+	void ComposeTransforms(const TRSArrays& trs, glm::mat4* out) {
+		ForEachBatch(trs.Size(), [&](auto tag, size_t begin, size_t end) {
+			using F = decltype(tag);
+			const F half = F::Set(0.5f), one = F::Set(1.0f), two = F::Set(2.0f);
+			for (size_t i = begin; i < end; i += F::Width) {
+				// quaternion from Euler angles, as glm::quat(eulerAngles)
+				F sx, cx, sy, cy, sz, cz;
+				SinCos(F::Load(&trs.rotationX[i]) * half, sx, cx);
+				SinCos(F::Load(&trs.rotationY[i]) * half, sy, cy);
+				SinCos(F::Load(&trs.rotationZ[i]) * half, sz, cz);
+				F qw = cx * cy * cz + sx * sy * sz;
+				F qx = sx * cy * cz - cx * sy * sz;
+				F qy = cx * sy * cz + sx * cy * sz;
+				F qz = cx * cy * sz - sx * sy * cz;
+
+				// rotation matrix as glm::toMat4, columns scaled
+				F xx = qx * qx, yy = qy * qy, zz = qz * qz;
+				F xy = qx * qy, xz = qx * qz, yz = qy * qz;
+				F wx = qw * qx, wy = qw * qy, wz = qw * qz;
+				F scaleX = F::Load(&trs.scaleX[i]), scaleY = F::Load(&trs.scaleY[i]), scaleZ = F::Load(&trs.scaleZ[i]);
+				F columns[12] = {
+					(one - two * (yy + zz)) * scaleX, two * (xy + wz) * scaleX, two * (xz - wy) * scaleX,
+					two * (xy - wz) * scaleY, (one - two * (xx + zz)) * scaleY, two * (yz + wx) * scaleY,
+					two * (xz + wy) * scaleZ, two * (yz - wx) * scaleZ, (one - two * (xx + yy)) * scaleZ,
+					F::Load(&trs.translationX[i]), F::Load(&trs.translationY[i]), F::Load(&trs.translationZ[i]),
+				};
+
+				// SoA to AoS
+				float lanes[12][F::Width];
+				for (int e = 0; e < 12; e++)
+					columns[e].Store(lanes[e]);
+				for (size_t lane = 0; lane < F::Width; lane++) {
+					glm::mat4& m = out[i + lane];
+					for (int c = 0; c < 4; c++) {
+						m[c] = { lanes[3 * c][lane], lanes[3 * c + 1][lane], lanes[3 * c + 2][lane], c == 3 ? 1.0f : 0.0f };
+					}
+				}
+			}
+		});
+	}
+
+	void TransformPoints(const glm::mat4& matrix, const float* x, const float* y, const float* z, size_t count, float* outX, float* outY, float* outZ) {
+		ForEachBatch(count, [&](auto tag, size_t begin, size_t end) {
+			using F = decltype(tag);
+			F m[4][3];
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 3; r++)
+					m[c][r] = F::Set(matrix[c][r]);
+			for (size_t i = begin; i < end; i += F::Width) {
+				F px = F::Load(x + i), py = F::Load(y + i), pz = F::Load(z + i);
+				(m[0][0] * px + m[1][0] * py + m[2][0] * pz + m[3][0]).Store(outX + i);
+				(m[0][1] * px + m[1][1] * py + m[2][1] * pz + m[3][1]).Store(outY + i);
+				(m[0][2] * px + m[1][2] * py + m[2][2] * pz + m[3][2]).Store(outZ + i);
+			}
+		});
+	}
+
+	void Distances(const float* x, const float* y, const float* z, size_t count, const glm::vec3& origin, float* out) {
+		ForEachBatch(count, [&](auto tag, size_t begin, size_t end) {
+			using F = decltype(tag);
+			const F ox = F::Set(origin.x), oy = F::Set(origin.y), oz = F::Set(origin.z);
+			for (size_t i = begin; i < end; i += F::Width) {
+				F dx = F::Load(x + i) - ox, dy = F::Load(y + i) - oy, dz = F::Load(z + i) - oz;
+				Sqrt(dx * dx + dy * dy + dz * dz).Store(out + i);
+			}
+		});
+	}
+
+	void TransformAABBs(const glm::mat4* matrices, const AABBArrays& boxes, AABBArrays& out) {
+		out.Resize(boxes.Size());
+		const float* inMin[3] = { boxes.minX.data(), boxes.minY.data(), boxes.minZ.data() };
+		const float* inMax[3] = { boxes.maxX.data(), boxes.maxY.data(), boxes.maxZ.data() };
+		float* outMin[3] = { out.minX.data(), out.minY.data(), out.minZ.data() };
+		float* outMax[3] = { out.maxX.data(), out.maxY.data(), out.maxZ.data() };
+		// Arvo's method: each output extent is the translation plus, per input axis, the smaller/larger of the two scaled extents
+		ForEachBatch(boxes.Size(), [&](auto tag, size_t begin, size_t end) {
+			using F = decltype(tag);
+			for (size_t i = begin; i < end; i += F::Width) {
+				const float* m = glm::value_ptr(matrices[i]);
+				F boxMin[3], boxMax[3];
+				for (int c = 0; c < 3; c++) {
+					boxMin[c] = F::Load(inMin[c] + i);
+					boxMax[c] = F::Load(inMax[c] + i);
+				}
+				for (int r = 0; r < 3; r++) {
+					F translation = F::Gather(m + 12 + r, 16);
+					F newMin = translation, newMax = translation;
+					for (int c = 0; c < 3; c++) {
+						F element = F::Gather(m + 4 * c + r, 16);
+						F a = element * boxMin[c];
+						F b = element * boxMax[c];
+						newMin = newMin + Min(a, b);
+						newMax = newMax + Max(a, b);
+					}
+					newMin.Store(outMin[r] + i);
+					newMax.Store(outMax[r] + i);
+				}
+			}
+		});
+	}
+
+	void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+		// Gribb-Hartmann, from the rows of the matrix
+		glm::mat4 m = glm::transpose(viewProjection);
+		planes[0] = m[3] + m[0]; // left
+		planes[1] = m[3] - m[0]; // right
+		planes[2] = m[3] + m[1]; // bottom
+		planes[3] = m[3] - m[1]; // top
+		planes[4] = m[3] + m[2]; // near
+		planes[5] = m[3] - m[2]; // far
+		for (int i = 0; i < 6; i++) {
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+	}
+
+	void CullBounds(const glm::vec4 planes[6], const AABBArrays& boxes, const float* radii, const glm::vec3& cameraPosition, float projectionScale, float minScreenSize, uint8_t* visible) {
+		ForEachBatch(boxes.Size(), [&](auto tag, size_t begin, size_t end) {
+			using F = decltype(tag);
+			F normal[6][3], absNormal[6][3], offset[6];
+			for (int p = 0; p < 6; p++) {
+				for (int k = 0; k < 3; k++) {
+					normal[p][k] = F::Set(planes[p][k]);
+					absNormal[p][k] = F::Set(std::abs(planes[p][k]));
+				}
+				offset[p] = F::Set(planes[p].w);
+			}
+			const F half = F::Set(0.5f);
+			const F camera[3] = { F::Set(cameraPosition.x), F::Set(cameraPosition.y), F::Set(cameraPosition.z) };
+			const F scale = F::Set(projectionScale);
+
+			for (size_t i = begin; i < end; i += F::Width) {
+				F minimum[3] = { F::Load(&boxes.minX[i]), F::Load(&boxes.minY[i]), F::Load(&boxes.minZ[i]) };
+				F maximum[3] = { F::Load(&boxes.maxX[i]), F::Load(&boxes.maxY[i]), F::Load(&boxes.maxZ[i]) };
+				F center[3], extent[3];
+				for (int k = 0; k < 3; k++) {
+					center[k] = (minimum[k] + maximum[k]) * half;
+					extent[k] = (maximum[k] - minimum[k]) * half;
+				}
+
+				// signed distance of the box corner farthest along each plane normal. Negative for any plane means outside.
+				F planeDistance = F::Set(std::numeric_limits<float>::max());
+				for (int p = 0; p < 6; p++) {
+					F d = normal[p][0] * center[0] + normal[p][1] * center[1] + normal[p][2] * center[2] + offset[p]
+						+ absNormal[p][0] * extent[0] + absNormal[p][1] * extent[1] + absNormal[p][2] * extent[2];
+					planeDistance = Min(planeDistance, d);
+				}
+
+				// projected diameter of the bounding sphere over screen height, approximately radius * scale / distance
+				F dx = center[0] - camera[0], dy = center[1] - camera[1], dz = center[2] - camera[2];
+				F radius = F::Load(radii + i);
+				F screenSize = radius * scale / Max(Sqrt(dx * dx + dy * dy + dz * dz), radius);
+
+				float planeDistances[F::Width], screenSizes[F::Width];
+				planeDistance.Store(planeDistances);
+				screenSize.Store(screenSizes);
+				for (size_t lane = 0; lane < F::Width; lane++) {
+					visible[i + lane] = planeDistances[lane] >= 0.0f && screenSizes[lane] >= minScreenSize;
+				}
+			}
+		});
+	}
+}
@@ -1,9 +1,47 @@
 #pragma once
 
+#include <stdint.h>
+#include <vector>
+
 #include <glm/glm.hpp>
 
 namespace Math {
 	bool DecomposeTransform(const glm::mat4& transform, glm::vec3& translation, glm::vec3& rotation, glm::vec3& scale);
-}
 
+	// Batch kernels on structure-of-arrays data. They use AVX2 when the compiler targets it (/arch:AVX2), SSE2 on x64, scalar code otherwise.
+	const char* GetSIMDName();
+
+	struct TRSArrays {
+		std::vector<float> translationX, translationY, translationZ;
+		std::vector<float> rotationX, rotationY, rotationZ; // Euler angles in radians
+		std::vector<float> scaleX, scaleY, scaleZ;
+
+		size_t Size() const { return translationX.size(); }
+		void Resize(size_t count);
+		void Set(size_t index, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale);
+	};
+
+	struct AABBArrays {
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+
+		size_t Size() const { return minX.size(); }
+		void Resize(size_t count);
+		void Set(size_t index, const glm::vec3& min, const glm::vec3& max);
+	};
+
+	// translate * rotate * scale for each element, same as TransformComponent::ComputeLocalTransform up to float precision
+	void ComposeTransforms(const TRSArrays& trs, glm::mat4* out);
+	// (matrix * vec4(p, 1)).xyz for each point
+	void TransformPoints(const glm::mat4& matrix, const float* x, const float* y, const float* z, size_t count, float* outX, float* outY, float* outZ);
+	// distance of each point to origin
+	void Distances(const float* x, const float* y, const float* z, size_t count, const glm::vec3& origin, float* out);
+	// Axis aligned bounds of each box transformed by its own affine matrix
+	void TransformAABBs(const glm::mat4* matrices, const AABBArrays& boxes, AABBArrays& out);
 
+	// Normalized planes of the frustum, points p inside satisfy dot(plane.xyz, p) + plane.w >= 0 for all planes
+	void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+	// visible[i] is 1 when box i intersects the frustum and its bounding sphere of radii[i] covers at least minScreenSize of the screen height.
+	// projectionScale is projection[1][1] of a perspective projection. minScreenSize of 0 disables the size test.
+	void CullBounds(const glm::vec4 planes[6], const AABBArrays& boxes, const float* radii, const glm::vec3& cameraPosition, float projectionScale, float minScreenSize, uint8_t* visible);
+}
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "BSPTree.h"
+
+#include <algorithm>
+#include <limits>
+
+BSPTree::BSPTree(const std::vector<glm::vec3>& positions, const std::vector<glm::uvec3>& triangles) :
+	positions(positions) {
+	if (positions.empty() || triangles.empty()) return;
+
+	glm::vec3 min = positions[0], max = positions[0];
+	for (const glm::vec3& p : positions) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	epsilon = 1e-5f * std::max(glm::length(max - min), 1e-6f);
+
+	// Nodes are built depth-first with an explicit stack, degenerate inputs can make the tree very deep
+	struct Task {
+		int32_t node;
+		std::vector<glm::uvec3> triangles;
+	};
+	std::vector<Task> tasks;
+	nodes.emplace_back();
+	tasks.push_back({ 0, triangles });
+	while (!tasks.empty()) {
+		Task task = std::move(tasks.back());
+		tasks.pop_back();
+
+		uint32_t firstTriangle = (uint32_t)this->triangles.size();
+		int32_t splitter = ChooseSplitter(task.triangles);
+		// only degenerate triangles are left, they don't have a plane. Draw them in any order.
+		if (splitter < 0) {
+			this->triangles.insert(this->triangles.end(), task.triangles.begin(), task.triangles.end());
+			nodes[task.node].plane = { 0.0f, 0.0f, 0.0f, 0.0f };
+			nodes[task.node].firstTriangle = firstTriangle;
+			nodes[task.node].triangleCount = (uint32_t)task.triangles.size();
+			continue;
+		}
+
+		glm::vec4 plane = TrianglePlane(task.triangles[splitter]);
+		std::vector<glm::uvec3> front, back;
+		for (const glm::uvec3& triangle : task.triangles) {
+			float distances[3];
+			int numFront = 0, numBack = 0;
+			for (int j = 0; j < 3; j++) {
+				distances[j] = glm::dot(glm::vec3(plane), this->positions[triangle[j]]) + plane.w;
+				if (distances[j] > epsilon) numFront++;
+				else if (distances[j] < -epsilon) numBack++;
+			}
+
+			if (numFront == 0 && numBack == 0)
+				this->triangles.push_back(triangle);
+			else if (numBack == 0)
+				front.push_back(triangle);
+			else if (numFront == 0)
+				back.push_back(triangle);
+			else
+				SplitTriangle(triangle, distances, front, back);
+		}
+
+		nodes[task.node].plane = plane;
+		nodes[task.node].firstTriangle = firstTriangle;
+		nodes[task.node].triangleCount = (uint32_t)this->triangles.size() - firstTriangle;
+		if (!front.empty()) {
+			int32_t child = (int32_t)nodes.size();
+			nodes.emplace_back();
+			nodes[task.node].front = child;
+			tasks.push_back({ child, std::move(front) });
+		}
+		if (!back.empty()) {
+			int32_t child = (int32_t)nodes.size();
+			nodes.emplace_back();
+			nodes[task.node].back = child;
+			tasks.push_back({ child, std::move(back) });
+		}
+	}
+}
+
+glm::vec4 BSPTree::TrianglePlane(const glm::uvec3& triangle) const {
+	const glm::vec3& a = positions[triangle[0]];
+	glm::vec3 normal = glm::cross(positions[triangle[1]] - a, positions[triangle[2]] - a);
+	float length = glm::length(normal);
+	if (length <= epsilon * epsilon) return { 0.0f, 0.0f, 0.0f, 0.0f };
+	normal /= length;
+	return { normal, -glm::dot(normal, a) };
+}
+
+int32_t BSPTree::ChooseSplitter(const std::vector<glm::uvec3>& candidates) const {
+	// Score a sample of candidate planes against a sample of the triangles. Fewer splits first, then balance.
+	const uint32_t numCandidates = 16;
+	const uint32_t numTested = 256;
+	const uint32_t count = (uint32_t)candidates.size();
+	const uint32_t candidateStep = std::max(1u, count / numCandidates);
+	const uint32_t testStep = std::max(1u, count / numTested);
+
+	int32_t best = -1;
+	float bestScore = std::numeric_limits<float>::max();
+	for (uint32_t c = 0; c < count; c += candidateStep) {
+		glm::vec4 plane = TrianglePlane(candidates[c]);
+		if (plane == glm::vec4(0.0f)) continue;
+
+		int numFront = 0, numBack = 0, numSplit = 0;
+		for (uint32_t t = 0; t < count; t += testStep) {
+			bool hasFront = false, hasBack = false;
+			for (int j = 0; j < 3; j++) {
+				float distance = glm::dot(glm::vec3(plane), positions[candidates[t][j]]) + plane.w;
+				hasFront |= distance > epsilon;
+				hasBack |= distance < -epsilon;
+			}
+			if (hasFront && hasBack) numSplit++;
+			else if (hasFront) numFront++;
+			else if (hasBack) numBack++;
+		}
+		float score = 8.0f * numSplit + (float)std::abs(numFront - numBack);
+		if (score < bestScore) {
+			bestScore = score;
+			best = (int32_t)c;
+		}
+	}
+
+	// sampled candidates were all degenerate
+	if (best < 0) {
+		for (uint32_t c = 0; c < count; c++) {
+			if (TrianglePlane(candidates[c]) != glm::vec4(0.0f))
+				return (int32_t)c;
+		}
+	}
+	return best;
+}
+
+void BSPTree::SplitTriangle(const glm::uvec3& triangle, const float distances[3], std::vector<glm::uvec3>& front, std::vector<glm::uvec3>& back) {
+	// Clip the triangle into a front and a back polygon of at most 4 vertices each. Vertices on the plane go to both.
+	uint32_t frontPolygon[4], backPolygon[4];
+	int numFront = 0, numBack = 0;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		float di = distances[i];
+		float dj = distances[j];
+		if (di >= -epsilon) frontPolygon[numFront++] = triangle[i];
+		if (di <= epsilon) backPolygon[numBack++] = triangle[i];
+
+		if ((di > epsilon && dj < -epsilon) || (di < -epsilon && dj > epsilon)) {
+			float t = di / (di - dj);
+			glm::vec3 intersection = glm::mix(positions[triangle[i]], positions[triangle[j]], t);
+			positions.push_back(intersection);
+			uint32_t newVertex = (uint32_t)positions.size() - 1;
+			frontPolygon[numFront++] = newVertex;
+			backPolygon[numBack++] = newVertex;
+		}
+	}
+
+	for (int k = 1; k + 1 < numFront; k++)
+		front.push_back({ frontPolygon[0], frontPolygon[k], frontPolygon[k + 1] });
+	for (int k = 1; k + 1 < numBack; k++)
+		back.push_back({ backPolygon[0], backPolygon[k], backPolygon[k + 1] });
+}
+
+void BSPTree::Traverse(const glm::vec3& eye, std::vector<uint32_t>& order) const {
+	if (nodes.empty()) return;
+
+	// far subtree, then triangles on the plane, then near subtree
+	struct Entry {
+		int32_t node;
+		bool isEmit;
+	};
+	std::vector<Entry> stack;
+	stack.push_back({ 0, false });
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[entry.node];
+		if (entry.isEmit) {
+			for (uint32_t t = node.firstTriangle; t < node.firstTriangle + node.triangleCount; t++)
+				order.push_back(t);
+			continue;
+		}
+
+		bool isEyeInFront = glm::dot(glm::vec3(node.plane), eye) + node.plane.w > 0.0f;
+		int32_t nearChild = isEyeInFront ? node.front : node.back;
+		int32_t farChild = isEyeInFront ? node.back : node.front;
+		// pushed in reverse, the far child is visited first
+		if (nearChild >= 0) stack.push_back({ nearChild, false });
+		stack.push_back({ entry.node, true });
+		if (farChild >= 0) stack.push_back({ farChild, false });
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Binary space partitioning of a static triangle mesh. Built once, triangles crossing a splitting plane are split.
+// Traversing it from any eye position gives an exact back-to-front order in linear time, even for intersecting triangles.
+class BSPTree {
+public:
+	struct Node {
+		glm::vec4 plane; // xyz normal, w offset. Points p with dot(normal, p) + w > 0 are in front.
+		int32_t front = -1;
+		int32_t back = -1;
+		uint32_t firstTriangle = 0; // triangles lying on the plane
+		uint32_t triangleCount = 0;
+	};
+
+	BSPTree() = default;
+	BSPTree(const std::vector<glm::vec3>& positions, const std::vector<glm::uvec3>& triangles);
+
+	// Appends indices into GetTriangles() to order, farthest from the eye first. eye is in object-space of the mesh.
+	void Traverse(const glm::vec3& eye, std::vector<uint32_t>& order) const;
+
+	// Original vertices followed by vertices created by splits
+	const std::vector<glm::vec3>& GetPositions() const { return positions; }
+	// Triangles grouped by node, triangles of a node are contiguous
+	const std::vector<glm::uvec3>& GetTriangles() const { return triangles; }
+	const std::vector<Node>& GetNodes() const { return nodes; }
+private:
+	int32_t ChooseSplitter(const std::vector<glm::uvec3>& candidates) const;
+	glm::vec4 TrianglePlane(const glm::uvec3& triangle) const;
+	void SplitTriangle(const glm::uvec3& triangle, const float distances[3], std::vector<glm::uvec3>& front, std::vector<glm::uvec3>& back);
+private:
+	std::vector<glm::vec3> positions;
+	std::vector<glm::uvec3> triangles;
+	std::vector<Node> nodes;
+	float epsilon = 1e-5f; // relative to the size of the mesh
+};
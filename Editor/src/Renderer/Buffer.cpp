@@ -32,10 +32,19 @@ void VertexBuffer::Update(const void* vertices, uint32_t size) {
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
+void VertexBuffer::SetData(const void* vertices, uint32_t size, uint32_t offset) {
+    glNamedBufferSubData(rendererID, offset, size, vertices);
+}
+
 /**
  * Index Buffer
  */
 
+IndexBuffer::IndexBuffer()
+    : count(0) {
+    glCreateBuffers(1, &rendererID);
+}
+
 IndexBuffer::IndexBuffer(uint32_t* indices, uint32_t count)
     : count(count) {
     glCreateBuffers(1, &rendererID);
@@ -61,3 +70,57 @@ void IndexBuffer::Update(uint32_t* indices, uint32_t count) {
     glBufferData(GL_ARRAY_BUFFER, count * sizeof(uint32_t), indices, GL_STATIC_DRAW);
     this->count = count;
 }
+
+void IndexBuffer::SetData(const uint32_t* indices, uint32_t count, uint32_t offset) {
+    glNamedBufferSubData(rendererID, offset * sizeof(uint32_t), count * sizeof(uint32_t), indices);
+}
+
+/**
+ * Uniform Buffer
+ */
+
+UniformBuffer::UniformBuffer(uint32_t size, uint32_t binding) {
+    glCreateBuffers(1, &rendererID);
+    glNamedBufferData(rendererID, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, rendererID);
+}
+
+UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &rendererID);
+}
+
+void UniformBuffer::SetData(const void* data, uint32_t size, uint32_t offset) {
+    glNamedBufferSubData(rendererID, offset, size, data);
+}
+
+/**
+ * Draw Indirect Buffer
+ */
+
+DrawIndirectBuffer::DrawIndirectBuffer() {
+    glCreateBuffers(1, &rendererID);
+}
+
+DrawIndirectBuffer::~DrawIndirectBuffer() {
+    glDeleteBuffers(1, &rendererID);
+}
+
+void DrawIndirectBuffer::Bind() const {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, rendererID);
+}
+
+/**
+ * Shader Storage Buffer
+ */
+
+ShaderStorageBuffer::ShaderStorageBuffer() {
+    glCreateBuffers(1, &rendererID);
+}
+
+ShaderStorageBuffer::~ShaderStorageBuffer() {
+    glDeleteBuffers(1, &rendererID);
+}
+
+void ShaderStorageBuffer::BindRange(uint32_t binding, uint32_t offset, uint32_t size) const {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, rendererID, offset, size);
+}
@@ -105,6 +105,9 @@ public:
 	void Unbind() const;
 
 	void Update(const void* vertices, uint32_t size);
+	// Overwrites part of the buffer without reallocating it
+	void SetData(const void* vertices, uint32_t size, uint32_t offset);
+	uint32_t GetRendererID() const { return rendererID; }
 
 	void SetLayout(const BufferLayout& layout) { Layout = layout; }
 	const BufferLayout& GetLayout() const { return Layout; }
@@ -115,6 +118,8 @@ private:
 
 class IndexBuffer {
 public:
+	// Create IndexBuffer without storage
+	IndexBuffer();
 	IndexBuffer(uint32_t* indices, uint32_t count);
 	~IndexBuffer();
 
@@ -122,9 +127,55 @@ public:
 	void Unbind() const;
 
 	void Update(uint32_t* indices, uint32_t count);
+	// Overwrites count indices starting at index offset without reallocating the buffer
+	void SetData(const uint32_t* indices, uint32_t count, uint32_t offset);
+	uint32_t GetRendererID() const { return rendererID; }
 
 	uint32_t GetCount() const { return count; };
 private:
 	uint32_t rendererID;
 	uint32_t count;
 };
+
+// Block of shader uniforms, bound once to a fixed binding point that shaders declare with layout(std140, binding = N)
+class UniformBuffer {
+public:
+	UniformBuffer(uint32_t size, uint32_t binding);
+	~UniformBuffer();
+
+	void SetData(const void* data, uint32_t size, uint32_t offset = 0);
+private:
+	uint32_t rendererID;
+};
+
+// Layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+class DrawIndirectBuffer {
+public:
+	DrawIndirectBuffer();
+	~DrawIndirectBuffer();
+
+	void Bind() const;
+	uint32_t GetRendererID() const { return rendererID; }
+private:
+	uint32_t rendererID;
+};
+
+class ShaderStorageBuffer {
+public:
+	ShaderStorageBuffer();
+	~ShaderStorageBuffer();
+
+	// Binds size bytes from offset to the shader storage block binding point
+	void BindRange(uint32_t binding, uint32_t offset, uint32_t size) const;
+	uint32_t GetRendererID() const { return rendererID; }
+private:
+	uint32_t rendererID;
+};
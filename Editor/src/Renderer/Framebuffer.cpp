@@ -4,6 +4,8 @@
 
 #include <glad/glad.h>
 
+#include "RenderCommand.h"
+
 namespace { // Texture Utils
 	static GLenum TextureTarget(bool multisampled) {
 		return multisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
@@ -13,8 +15,9 @@ namespace { // Texture Utils
 		glCreateTextures(TextureTarget(multisampled), count, outID);
 	}
 
-	static void BindTexture(bool multisampled, uint32_t id) {
-		glBindTexture(TextureTarget(multisampled), id);
+	// to unit 0, the active one, for the non-DSA calls below
+	static void BindTexture(uint32_t id) {
+		RenderCommand::BindTextureUnit(0, id);
 	}
 
 	static void AttachColorTexture(uint32_t id, int samples, GLenum internalFormat, GLenum format, uint32_t width, uint32_t height, int index) {
@@ -25,9 +28,10 @@ namespace { // Texture Utils
 		else {
 			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
 
-			// Will be set by framebuffer specification in the future
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			// Will be set by framebuffer specification in the future. Integer textures are incomplete with linear filtering.
+			GLint filter = format == GL_RED_INTEGER ? GL_NEAREST : GL_LINEAR;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -58,6 +62,7 @@ namespace { // Texture Utils
 	static bool IsDepthFormat(FramebufferTextureFormat format) {
 		switch (format) {
 		case FramebufferTextureFormat::DEPTH24STENCIL8: return true;
+		default: break;
 		}
 		return false;
 	}
@@ -65,6 +70,8 @@ namespace { // Texture Utils
 	static GLenum FramebufferTextureFormatToGL(FramebufferTextureFormat format) {
 		switch (format) {
 		case FramebufferTextureFormat::RGBA8: return GL_RGBA8;
+		case FramebufferTextureFormat::RGBA16F: return GL_RGBA;
+		case FramebufferTextureFormat::R16F: return GL_RED;
 		case FramebufferTextureFormat::RED_INTEGER: return GL_RED_INTEGER;
 		}
 		assert(false); // unknown format
@@ -84,6 +91,13 @@ Framebuffer::Framebuffer(const FramebufferSpecification& spec)
 }
 
 Framebuffer::~Framebuffer() {
+	Release();
+}
+
+void Framebuffer::Release() {
+	RenderCommand::OnFramebufferDeleted(rendererID);
+	RenderCommand::OnTexturesDeleted(colorAttachmentRendererIDs.data(), (uint32_t)colorAttachmentRendererIDs.size());
+	RenderCommand::OnTexturesDeleted(&depthAttachmentRendererID, 1);
 	glDeleteFramebuffers(1, &rendererID);
 	glDeleteTextures((GLsizei)colorAttachmentRendererIDs.size(), colorAttachmentRendererIDs.data());
 	glDeleteTextures(1, &depthAttachmentRendererID);
@@ -91,16 +105,14 @@ Framebuffer::~Framebuffer() {
 
 void Framebuffer::Invalidate() {
 	if (rendererID) {
-		glDeleteFramebuffers(1, &rendererID);
-		glDeleteTextures((GLsizei)colorAttachmentRendererIDs.size(), colorAttachmentRendererIDs.data());
-		glDeleteTextures(1, &depthAttachmentRendererID);
+		Release();
 
 		colorAttachmentRendererIDs.clear();
 		depthAttachmentRendererID = 0;
 	}
 
 	glCreateFramebuffers(1, &rendererID);
-	glBindFramebuffer(GL_FRAMEBUFFER, rendererID);
+	RenderCommand::BindFramebuffer(rendererID);
 
 	bool isMultisample = specification.Samples > 1;
 	// Attachments
@@ -108,11 +120,17 @@ void Framebuffer::Invalidate() {
 		colorAttachmentRendererIDs.resize(colorAttachmentSpecs.size());
 		CreateTextures(isMultisample, colorAttachmentRendererIDs.data(), (uint32_t)colorAttachmentRendererIDs.size());
 		for (size_t i = 0; i < colorAttachmentRendererIDs.size(); i++) {
-			BindTexture(isMultisample, colorAttachmentRendererIDs[i]);
+			BindTexture(colorAttachmentRendererIDs[i]);
 			switch (colorAttachmentSpecs[i].TextureFormat) {
 			case FramebufferTextureFormat::RGBA8:
 				AttachColorTexture(colorAttachmentRendererIDs[i], specification.Samples, GL_RGBA8, GL_RGBA, specification.Width, specification.Height, (int)i);
 				break;
+			case FramebufferTextureFormat::RGBA16F:
+				AttachColorTexture(colorAttachmentRendererIDs[i], specification.Samples, GL_RGBA16F, GL_RGBA, specification.Width, specification.Height, (int)i);
+				break;
+			case FramebufferTextureFormat::R16F:
+				AttachColorTexture(colorAttachmentRendererIDs[i], specification.Samples, GL_R16F, GL_RED, specification.Width, specification.Height, (int)i);
+				break;
 			case FramebufferTextureFormat::RED_INTEGER:
 				AttachColorTexture(colorAttachmentRendererIDs[i], specification.Samples, GL_R32I, GL_RED_INTEGER, specification.Width, specification.Height, (int)i);
 				break;
@@ -122,10 +140,13 @@ void Framebuffer::Invalidate() {
 
 	if (depthAttachmentSpec.TextureFormat != FramebufferTextureFormat::None) {
 		CreateTextures(isMultisample, &depthAttachmentRendererID, 1);
-		BindTexture(isMultisample, depthAttachmentRendererID);
+		BindTexture(depthAttachmentRendererID);
 		switch (depthAttachmentSpec.TextureFormat) {
 		case FramebufferTextureFormat::DEPTH24STENCIL8:
 			AttachDepthTexture(depthAttachmentRendererID, specification.Samples, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL_ATTACHMENT, specification.Width, specification.Height);
+			break;
+		default:
+			assert(false); // not a depth format
 		}
 	}
 
@@ -140,16 +161,16 @@ void Framebuffer::Invalidate() {
 
 	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE); // Framebuffer incomplete!
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	RenderCommand::BindFramebuffer(0);
 }
 
 void Framebuffer::Bind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, rendererID);
-	glViewport(0, 0, specification.Width, specification.Height);
+	RenderCommand::BindFramebuffer(rendererID);
+	RenderCommand::SetViewport(0, 0, specification.Width, specification.Height);
 }
 
 void Framebuffer::Unbind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	RenderCommand::BindFramebuffer(0);
 }
 
 void Framebuffer::Resize(uint32_t width, uint32_t height) {
@@ -174,3 +195,11 @@ void Framebuffer::ClearAttachment(uint32_t attachmentIndex, int value) {
 		FramebufferTextureFormatToGL(spec.TextureFormat), GL_INT, &value);
 }
 
+void Framebuffer::ClearAttachment(uint32_t attachmentIndex, float value) {
+	assert(attachmentIndex < colorAttachmentRendererIDs.size());
+
+	auto& spec = colorAttachmentSpecs[attachmentIndex];
+	float values[4] = { value, value, value, value };
+	glClearTexImage(colorAttachmentRendererIDs[attachmentIndex], 0,
+		FramebufferTextureFormatToGL(spec.TextureFormat), GL_FLOAT, values);
+}
\ No newline at end of file
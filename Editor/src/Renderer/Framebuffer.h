@@ -11,7 +11,8 @@ enum class FramebufferTextureFormat
 	// Color
 	RED_INTEGER,
 	RGBA8,
-	// RBGA16F will come here
+	RGBA16F,
+	R16F,
 
 	// Depth/stencil
 	DEPTH24STENCIL8,
@@ -52,6 +53,7 @@ public:
 	~Framebuffer();
 	
 	const FramebufferSpecification& GetSpecification() const { return specification; }
+	uint32_t GetRendererID() const { return rendererID; }
 	uint32_t GetColorAttachmentRendererID(uint32_t index = 0) const { 
 		assert(index < colorAttachmentRendererIDs.size()); 
 		return colorAttachmentRendererIDs[index]; 
@@ -66,6 +68,11 @@ public:
 	int ReadPixel(uint32_t attachmentIndex, int x, int y);
 
 	void ClearAttachment(uint32_t attachmentIndex, int value);
+	// Sets all channels of a floating-point attachment to value
+	void ClearAttachment(uint32_t attachmentIndex, float value);
+private:
+	// Deletes the framebuffer and its attachments
+	void Release();
 private:
 	uint32_t rendererID = 0;
 	FramebufferSpecification specification;
@@ -0,0 +1,143 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+
+bool GeometryArena::FreeList::Allocate(uint32_t count, uint32_t& offset) {
+	for (size_t i = 0; i < ranges.size(); i++) {
+		auto& [rangeOffset, rangeCount] = ranges[i];
+		if (rangeCount < count) continue;
+		offset = rangeOffset;
+		rangeOffset += count;
+		rangeCount -= count;
+		if (rangeCount == 0) {
+			ranges.erase(ranges.begin() + i);
+		}
+		used += count;
+		return true;
+	}
+	return false;
+}
+
+void GeometryArena::FreeList::Free(uint32_t offset, uint32_t count) {
+	used -= count;
+	auto next = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(offset, 0u));
+	auto it = ranges.insert(next, { offset, count });
+	// merge with the following then the preceding range
+	if (it + 1 != ranges.end() && it->first + it->second == (it + 1)->first) {
+		it->second += (it + 1)->second;
+		ranges.erase(it + 1);
+	}
+	if (it != ranges.begin() && (it - 1)->first + (it - 1)->second == it->first) {
+		(it - 1)->second += it->second;
+		ranges.erase(it);
+	}
+}
+
+uint32_t GeometryArena::FreeList::GetFragmentedCount() const {
+	uint32_t freeCount = capacity - used;
+	if (!ranges.empty() && ranges.back().first + ranges.back().second == capacity) {
+		freeCount -= ranges.back().second;
+	}
+	return freeCount;
+}
+
+void GeometryArena::FreeList::Reset(uint32_t capacity, uint32_t used) {
+	this->capacity = capacity;
+	this->used = used;
+	ranges.clear();
+	if (used < capacity) {
+		ranges.push_back({ used, capacity - used });
+	}
+}
+
+const GeometryArena::Range& GeometryArena::Acquire(uint64_t hash, const void* positions, size_t stride, size_t vertexCount, const std::vector<glm::uvec3>& triangles) {
+	auto it = geometries.find(hash);
+	if (it != geometries.end()) {
+		it->second.lastUsedFrame = frameIndex;
+		return it->second.range;
+	}
+
+	Range range = { 0, (uint32_t)vertexCount, 0, (uint32_t)(3 * triangles.size()) };
+	const bool hasVertices = vertices.Allocate(range.vertexCount, range.firstVertex);
+	const bool hasIndices = hasVertices && indices.Allocate(range.indexCount, range.firstIndex);
+	if (!hasIndices) {
+		if (hasVertices) {
+			vertices.Free(range.firstVertex, range.vertexCount);
+		}
+		// packing the ranges may be enough, the capacities grow only when it is not
+		uint32_t vertexCapacity = std::max(vertices.capacity, 1u << 16);
+		uint32_t indexCapacity = std::max(indices.capacity, 1u << 18);
+		while (vertexCapacity < vertices.used + range.vertexCount) vertexCapacity *= 2;
+		while (indexCapacity < indices.used + range.indexCount) indexCapacity *= 2;
+		Rebuild(vertexCapacity, indexCapacity);
+		vertices.Allocate(range.vertexCount, range.firstVertex);
+		indices.Allocate(range.indexCount, range.firstIndex);
+	}
+
+	std::vector<glm::vec3> packedPositions(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		packedPositions[i] = *reinterpret_cast<const glm::vec3*>(static_cast<const uint8_t*>(positions) + i * stride);
+	}
+	if (vertexCount > 0) {
+		vertexBuffer->SetData(packedPositions.data(), (uint32_t)(sizeof(glm::vec3) * vertexCount), (uint32_t)(sizeof(glm::vec3) * range.firstVertex));
+	}
+	if (range.indexCount > 0) {
+		indexBuffer->SetData(&triangles[0][0], range.indexCount, range.firstIndex);
+	}
+
+	Geometry& geometry = geometries[hash];
+	geometry = { range, frameIndex };
+	return geometry.range;
+}
+
+void GeometryArena::EndFrame(uint32_t maxUnusedFrames) {
+	for (auto it = geometries.begin(); it != geometries.end();) {
+		if (frameIndex - it->second.lastUsedFrame > maxUnusedFrames) {
+			vertices.Free(it->second.range.firstVertex, it->second.range.vertexCount);
+			indices.Free(it->second.range.firstIndex, it->second.range.indexCount);
+			it = geometries.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	if (vertices.GetFragmentedCount() > vertices.capacity / 4 || indices.GetFragmentedCount() > indices.capacity / 4) {
+		Compact();
+	}
+	frameIndex++;
+}
+
+void GeometryArena::Rebuild(uint32_t vertexCapacity, uint32_t indexCapacity) {
+	auto newVertexBuffer = std::make_shared<VertexBuffer>(nullptr, (uint32_t)(sizeof(glm::vec3) * vertexCapacity));
+	newVertexBuffer->SetLayout({
+		{ ShaderDataType::Float3, "a_Position" },
+	});
+	auto newIndexBuffer = std::make_shared<IndexBuffer>(nullptr, indexCapacity);
+
+	// copy the ranges in offset order so that they are packed in the same order
+	std::vector<Geometry*> sorted;
+	for (auto& [hash, geometry] : geometries) {
+		sorted.push_back(&geometry);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Geometry* a, const Geometry* b) { return a->range.firstVertex < b->range.firstVertex; });
+	uint32_t vertexOffset = 0, indexOffset = 0;
+	for (Geometry* geometry : sorted) {
+		Range& range = geometry->range;
+		glCopyNamedBufferSubData(vertexBuffer->GetRendererID(), newVertexBuffer->GetRendererID(),
+			sizeof(glm::vec3) * range.firstVertex, sizeof(glm::vec3) * vertexOffset, sizeof(glm::vec3) * range.vertexCount);
+		glCopyNamedBufferSubData(indexBuffer->GetRendererID(), newIndexBuffer->GetRendererID(),
+			sizeof(uint32_t) * range.firstIndex, sizeof(uint32_t) * indexOffset, sizeof(uint32_t) * range.indexCount);
+		range.firstVertex = vertexOffset;
+		range.firstIndex = indexOffset;
+		vertexOffset += range.vertexCount;
+		indexOffset += range.indexCount;
+	}
+
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	vertices.Reset(vertexCapacity, vertexOffset);
+	indices.Reset(indexCapacity, indexOffset);
+	generation++;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+
+// Positions and indices of many meshes in one shared vertex buffer and one shared index buffer, so that they can be drawn
+// with a single vertex array. Each geometry, identified by a hash of its contents, gets a range of vertices and a range of indices.
+// Indices are relative to the first vertex of their range, draws pass it as the base vertex.
+// Geometries that are not used for a while are freed, the buffers are compacted when too much space between ranges is free.
+class GeometryArena {
+public:
+	struct Range {
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	static GeometryArena& Instance() { static GeometryArena instance; return instance; }
+	GeometryArena(GeometryArena const&) = delete;
+	GeometryArena& operator=(GeometryArena const&) = delete;
+
+	// Range of the geometry with this hash, uploaded first when it is not in the arena. positions are read with the given byte stride.
+	// Ranges move when the arena grows or is compacted, look them up again after GetGeneration changes.
+	const Range& Acquire(uint64_t hash, const void* positions, size_t stride, size_t vertexCount, const std::vector<glm::uvec3>& triangles);
+	// Frees geometries not acquired in the last maxUnusedFrames calls, then compacts when fragmented
+	void EndFrame(uint32_t maxUnusedFrames = 300);
+
+	// Rebuilds the buffers with all ranges packed at the beginning
+	void Compact() { Rebuild(vertices.capacity, indices.capacity); }
+
+	// Changes whenever the buffers are replaced
+	uint32_t GetGeneration() const { return generation; }
+	const std::shared_ptr<VertexBuffer>& GetVertexBuffer() const { return vertexBuffer; }
+	const std::shared_ptr<IndexBuffer>& GetIndexBuffer() const { return indexBuffer; }
+	uint32_t GetUsedVertexCount() const { return vertices.used; }
+	uint32_t GetVertexCapacity() const { return vertices.capacity; }
+	uint32_t GetGeometryCount() const { return (uint32_t)geometries.size(); }
+private:
+	GeometryArena() = default;
+
+	// First-fit allocator of element ranges. Free ranges are sorted by offset and merged with their neighbors.
+	struct FreeList {
+		std::vector<std::pair<uint32_t, uint32_t>> ranges; // offset, count
+		uint32_t capacity = 0;
+		uint32_t used = 0;
+
+		bool Allocate(uint32_t count, uint32_t& offset);
+		void Free(uint32_t offset, uint32_t count);
+		// free elements that are not after the last allocation
+		uint32_t GetFragmentedCount() const;
+		void Reset(uint32_t capacity, uint32_t used);
+	};
+	struct Geometry {
+		Range range;
+		uint32_t lastUsedFrame;
+	};
+
+	void Rebuild(uint32_t vertexCapacity, uint32_t indexCapacity);
+private:
+	std::unordered_map<uint64_t, Geometry> geometries;
+	FreeList vertices;
+	FreeList indices;
+	std::shared_ptr<VertexBuffer> vertexBuffer;
+	std::shared_ptr<IndexBuffer> indexBuffer;
+	uint32_t generation = 0;
+	uint32_t frameIndex = 0;
+};
@@ -0,0 +1,122 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "../ThreadPool.h"
+
+void LightClusters::UpdateBounds(const glm::mat4& projection) {
+	boundsProjection = projection;
+	const glm::mat4 inverseProjection = glm::inverse(projection);
+	auto unproject = [&inverseProjection](float x, float y, float z) {
+		glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+		return glm::vec3(point) / point.w;
+	};
+	// View-space point of an NDC xy at a view depth, on the line between the near and the far plane.
+	// The line is straight for perspective and orthographic projections alike.
+	auto pointAtDepth = [&unproject](float x, float y, float depth) {
+		glm::vec3 nearPoint = unproject(x, y, -1.0f);
+		glm::vec3 farPoint = unproject(x, y, 1.0f);
+		float t = (depth + nearPoint.z) / (nearPoint.z - farPoint.z);
+		return nearPoint + t * (farPoint - nearPoint);
+	};
+
+	const float nearDepth = -unproject(0.0f, 0.0f, -1.0f).z;
+	const float farDepth = -unproject(0.0f, 0.0f, 1.0f).z;
+	// orthographic near planes can be at or behind the camera, the first slice takes the depths before sliceNear
+	sliceNear = std::max(nearDepth, 0.01f);
+	const float sliceFar = std::max(farDepth, 2.0f * sliceNear);
+	sliceScale = SliceCount / std::log(sliceFar / sliceNear);
+
+	sliceBounds.resize(SliceCount);
+	for (uint32_t slice = 0; slice < SliceCount; slice++) {
+		SliceBounds& bounds = sliceBounds[slice];
+		bounds.depth.x = slice == 0 ? std::min(nearDepth, sliceNear) : sliceNear * std::exp(slice / sliceScale);
+		bounds.depth.y = slice == SliceCount - 1 ? sliceFar : sliceNear * std::exp((slice + 1) / sliceScale);
+
+		// over the corners of the column or row at both ends of the slice
+		for (uint32_t column = 0; column < TileCountX; column++) {
+			bounds.columns[column] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+			for (float x : { -1.0f + 2.0f * column / TileCountX, -1.0f + 2.0f * (column + 1) / TileCountX }) {
+				for (float y : { -1.0f, 1.0f }) {
+					for (float depth : { bounds.depth.x, bounds.depth.y }) {
+						float pointX = pointAtDepth(x, y, depth).x;
+						bounds.columns[column] = { std::min(bounds.columns[column].x, pointX), std::max(bounds.columns[column].y, pointX) };
+					}
+				}
+			}
+		}
+		for (uint32_t row = 0; row < TileCountY; row++) {
+			bounds.rows[row] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+			for (float y : { -1.0f + 2.0f * row / TileCountY, -1.0f + 2.0f * (row + 1) / TileCountY }) {
+				for (float x : { -1.0f, 1.0f }) {
+					for (float depth : { bounds.depth.x, bounds.depth.y }) {
+						float pointY = pointAtDepth(x, y, depth).y;
+						bounds.rows[row] = { std::min(bounds.rows[row].x, pointY), std::max(bounds.rows[row].y, pointY) };
+					}
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::Assign(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (projection != boundsProjection) {
+		UpdateBounds(projection);
+	}
+
+	const uint32_t lightCount = (uint32_t)lights.size();
+	viewLights.resize(lightCount);
+	for (uint32_t i = 0; i < lightCount; i++) {
+		viewLights[i].center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position), 1.0f));
+		viewLights[i].radius = lights[i].range > 0.0f ? lights[i].range : std::numeric_limits<float>::infinity();
+	}
+
+	// Each slice is a job writing only its own clusters. Lights are tested against the box of each cluster they may
+	// overlap, and are appended in index order.
+	clusterLights.resize(ClusterCount);
+	ThreadPool::Instance().ParallelFor(SliceCount, [this, lightCount](uint32_t slice) {
+		const SliceBounds& bounds = sliceBounds[slice];
+		std::vector<uint32_t>* sliceLights = &clusterLights[slice * TileCountX * TileCountY];
+		for (uint32_t tile = 0; tile < TileCountX * TileCountY; tile++) {
+			sliceLights[tile].clear();
+		}
+
+		for (uint32_t i = 0; i < lightCount; i++) {
+			const Sphere& sphere = viewLights[i];
+			const float depth = -sphere.center.z;
+			const float radiusSquared = sphere.radius * sphere.radius;
+			// distances from the center to the box along each axis, 0 inside of it
+			const float dz = std::max({ bounds.depth.x - depth, 0.0f, depth - bounds.depth.y });
+			if (dz * dz > radiusSquared) continue;
+			for (uint32_t row = 0; row < TileCountY; row++) {
+				const float dy = std::max({ bounds.rows[row].x - sphere.center.y, 0.0f, sphere.center.y - bounds.rows[row].y });
+				if (dy * dy + dz * dz > radiusSquared) continue;
+				for (uint32_t column = 0; column < TileCountX; column++) {
+					const float dx = std::max({ bounds.columns[column].x - sphere.center.x, 0.0f, sphere.center.x - bounds.columns[column].y });
+					if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+						sliceLights[row * TileCountX + column].push_back(i);
+					}
+				}
+			}
+		}
+	});
+
+	clusters.resize(ClusterCount);
+	lightIndices.clear();
+	occupiedClusterCount = 0;
+	maxClusterLightCount = 0;
+	for (uint32_t cluster = 0; cluster < ClusterCount; cluster++) {
+		const std::vector<uint32_t>& indices = clusterLights[cluster];
+		clusters[cluster] = { (uint32_t)lightIndices.size(), (uint32_t)indices.size() };
+		lightIndices.insert(lightIndices.end(), indices.begin(), indices.end());
+		occupiedClusterCount += !indices.empty();
+		maxClusterLightCount = std::max(maxClusterLightCount, (uint32_t)indices.size());
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastAssignMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+}
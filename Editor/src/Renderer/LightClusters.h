@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Assigns point lights to the clusters of a grid over the view frustum, for clustered forward shading. The grid is
+// TileCountX x TileCountY screen tiles by SliceCount depth slices, spaced exponentially in view depth. A fragment
+// looks up the cluster it is in and only visits that cluster's lights.
+class LightClusters {
+public:
+	static const uint32_t TileCountX = 16;
+	static const uint32_t TileCountY = 9;
+	static const uint32_t SliceCount = 24;
+	static const uint32_t ClusterCount = TileCountX * TileCountY * SliceCount;
+
+	// std430 layout of PointLight in the shaders
+	struct Light {
+		glm::vec4 position; // xyz position, w intensity
+		float range; // no effect beyond it, 0 for unlimited which puts the light in every cluster
+		float padding[3];
+	};
+
+	// Lights of a cluster are lightIndices[offset, offset + count). Clusters are ordered by slice, then tile row and column.
+	struct Cluster {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// Assigns world-space lights for a camera. Depth slices are split among ThreadPool threads.
+	void Assign(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection);
+
+	const std::vector<Cluster>& GetClusters() const { return clusters; }
+	const std::vector<uint32_t>& GetLightIndices() const { return lightIndices; }
+	// A fragment at view depth d is in slice log(d / sliceNear) * sliceScale, clamped to the slices
+	float GetSliceNear() const { return sliceNear; }
+	float GetSliceScale() const { return sliceScale; }
+
+	uint32_t GetOccupiedClusterCount() const { return occupiedClusterCount; }
+	uint32_t GetMaxClusterLightCount() const { return maxClusterLightCount; }
+	float GetLastAssignMilliseconds() const { return lastAssignMilliseconds; }
+private:
+	// Recomputes the view-space bounds of the clusters for a new projection
+	void UpdateBounds(const glm::mat4& projection);
+private:
+	glm::mat4 boundsProjection = glm::mat4(0.0f);
+	// The view-space bounds of a cluster are those of its column across x, its row across y and its slice across depth
+	struct SliceBounds {
+		glm::vec2 depth; // min, max
+		glm::vec2 columns[TileCountX]; // min, max x
+		glm::vec2 rows[TileCountY]; // min, max y
+	};
+	std::vector<SliceBounds> sliceBounds;
+	float sliceNear = 1.0f;
+	float sliceScale = 1.0f;
+
+	struct Sphere {
+		glm::vec3 center;
+		float radius;
+	};
+	std::vector<Sphere> viewLights; // in view space
+	std::vector<std::vector<uint32_t>> clusterLights; // per cluster, storage kept between frames
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> lightIndices;
+	uint32_t occupiedClusterCount = 0;
+	uint32_t maxClusterLightCount = 0;
+	float lastAssignMilliseconds = 0.0f;
+};
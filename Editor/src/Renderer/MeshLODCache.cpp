@@ -0,0 +1,23 @@
+#include "MeshLODCache.h"
+
+#include "../ThreadPool.h"
+
+std::shared_ptr<const MeshLODCache::Chain> MeshLODCache::Request(const std::string& key, const void* positions, size_t stride, size_t vertexCount, const std::vector<glm::uvec3>& triangles) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = chains.find(key);
+	if (it != chains.end()) {
+		return it->second;
+	}
+	chains[key] = nullptr;
+
+	std::vector<glm::vec3> positionCopy(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		positionCopy[i] = *reinterpret_cast<const glm::vec3*>(static_cast<const uint8_t*>(positions) + i * stride);
+	}
+	ThreadPool::Instance().Enqueue([this, key, positions = std::move(positionCopy), triangles]() {
+		auto chain = std::make_shared<const Chain>(MeshSimplifier::BuildLODChain(positions, triangles));
+		std::lock_guard<std::mutex> lock(mutex);
+		chains[key] = chain;
+	});
+	return nullptr;
+}
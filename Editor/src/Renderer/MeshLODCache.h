@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MeshSimplifier.h"
+
+// LOD chains of meshes, built on worker threads and shared by all meshes with the same key (e.g. the geometry hash of the mesh)
+class MeshLODCache {
+public:
+	using Chain = std::vector<MeshSimplifier::Level>;
+
+	static MeshLODCache& Instance() { static MeshLODCache instance; return instance; }
+	MeshLODCache(MeshLODCache const&) = delete;
+	MeshLODCache& operator=(MeshLODCache const&) = delete;
+
+	// Returns the chain if it is built. Otherwise returns nullptr, and the first request of a key starts building it in the background.
+	// positions are read with the given byte stride, the mesh is copied only when the build starts.
+	std::shared_ptr<const Chain> Request(const std::string& key, const void* positions, size_t stride, size_t vertexCount, const std::vector<glm::uvec3>& triangles);
+private:
+	MeshLODCache() = default;
+private:
+	std::mutex mutex;
+	// null while the chain is being built
+	std::unordered_map<std::string, std::shared_ptr<const Chain>> chains;
+};
@@ -0,0 +1,294 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+namespace MeshSimplifier {
+	// Symmetric 4x4 matrix Q, the error of position v is [v 1] Q [v 1]^T. Doubles, the sums lose precision in floats.
+	struct Quadric {
+		// a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+		double a[10] = { 0.0 };
+
+		static Quadric FromPlane(const glm::dvec3& n, double d, double weight) {
+			Quadric q;
+			q.a[0] = n.x * n.x; q.a[1] = n.x * n.y; q.a[2] = n.x * n.z; q.a[3] = n.x * d;
+			q.a[4] = n.y * n.y; q.a[5] = n.y * n.z; q.a[6] = n.y * d;
+			q.a[7] = n.z * n.z; q.a[8] = n.z * d;
+			q.a[9] = d * d;
+			for (double& x : q.a) x *= weight;
+			return q;
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			for (int i = 0; i < 10; i++) a[i] += other.a[i];
+			return *this;
+		}
+
+		double Evaluate(const glm::dvec3& v) const {
+			return a[0] * v.x * v.x + 2.0 * a[1] * v.x * v.y + 2.0 * a[2] * v.x * v.z + 2.0 * a[3] * v.x
+				+ a[4] * v.y * v.y + 2.0 * a[5] * v.y * v.z + 2.0 * a[6] * v.y
+				+ a[7] * v.z * v.z + 2.0 * a[8] * v.z
+				+ a[9];
+		}
+
+		// Position minimizing the error, false when the system is close to singular (flat or linear neighborhoods)
+		bool Minimize(glm::dvec3& v) const {
+			glm::dmat3 m = { a[0], a[1], a[2], a[1], a[4], a[5], a[2], a[5], a[7] };
+			double det = glm::determinant(m);
+			double scale = a[0] * a[4] * a[7];
+			if (std::abs(det) <= 1e-6 * std::abs(scale) || det == 0.0) return false;
+			v = glm::inverse(m) * -glm::dvec3(a[3], a[6], a[8]);
+			return true;
+		}
+	};
+
+	struct Collapse {
+		double cost;
+		uint32_t a, b;
+		uint32_t stampA, stampB;
+		glm::dvec3 target;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	class Simplifier {
+	public:
+		Simplifier(const std::vector<glm::vec3>& inputPositions, const std::vector<glm::uvec3>& inputTriangles) {
+			// weld vertices with identical positions, the topology has to be connected for collapses to work
+			std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+			std::vector<uint32_t> remap(inputPositions.size());
+			for (uint32_t i = 0; i < (uint32_t)inputPositions.size(); i++) {
+				const glm::vec3& p = inputPositions[i];
+				uint32_t bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+				std::vector<uint32_t>& bucket = buckets[hash];
+				auto it = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t v) { return glm::vec3(positions[v]) == p; });
+				if (it != bucket.end()) {
+					remap[i] = *it;
+					continue;
+				}
+				remap[i] = (uint32_t)positions.size();
+				bucket.push_back(remap[i]);
+				positions.push_back(p);
+			}
+			for (const glm::uvec3& t : inputTriangles) {
+				glm::uvec3 triangle = { remap[t.x], remap[t.y], remap[t.z] };
+				if (triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x) continue;
+				triangles.push_back(triangle);
+			}
+			isTriangleRemoved.assign(triangles.size(), 0);
+			liveTriangleCount = triangles.size();
+
+			vertexTriangles.resize(positions.size());
+			for (uint32_t t = 0; t < (uint32_t)triangles.size(); t++) {
+				for (int j = 0; j < 3; j++) vertexTriangles[triangles[t][j]].push_back(t);
+			}
+			stamps.assign(positions.size(), 0);
+			isVertexRemoved.assign(positions.size(), 0);
+			ComputeQuadrics();
+
+			for (uint32_t t = 0; t < (uint32_t)triangles.size(); t++) {
+				for (int j = 0; j < 3; j++) {
+					uint32_t a = triangles[t][j], b = triangles[t][(j + 1) % 3];
+					// each interior edge is seen twice, once per direction
+					if (a < b || IsBoundaryEdge(a, b)) PushCollapse(a, b);
+				}
+			}
+		}
+
+		// Collapses edges until at most targetTriangleCount triangles are left. Returns false when it ran out of collapses.
+		bool Run(size_t targetTriangleCount) {
+			while (liveTriangleCount > targetTriangleCount) {
+				if (heap.empty()) return false;
+				Collapse collapse = heap.top();
+				heap.pop();
+				if (isVertexRemoved[collapse.a] || isVertexRemoved[collapse.b]) continue;
+				if (stamps[collapse.a] != collapse.stampA || stamps[collapse.b] != collapse.stampB) continue;
+				if (!IsCollapseValid(collapse.a, collapse.b, collapse.target)) continue;
+				ApplyCollapse(collapse);
+			}
+			return true;
+		}
+
+		size_t GetTriangleCount() const { return liveTriangleCount; }
+
+		Level Snapshot() const {
+			Level level;
+			level.Error = (float)maxError;
+			std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+			for (size_t t = 0; t < triangles.size(); t++) {
+				if (isTriangleRemoved[t]) continue;
+				glm::uvec3 triangle;
+				for (int j = 0; j < 3; j++) {
+					uint32_t v = triangles[t][j];
+					if (remap[v] == UINT32_MAX) {
+						remap[v] = (uint32_t)level.Positions.size();
+						level.Positions.push_back(glm::vec3(positions[v]));
+					}
+					triangle[j] = remap[v];
+				}
+				level.Triangles.push_back(triangle);
+			}
+			return level;
+		}
+	private:
+		void ComputeQuadrics() {
+			quadrics.assign(positions.size(), Quadric());
+			for (const glm::uvec3& t : triangles) {
+				glm::dvec3 normal = glm::cross(positions[t.y] - positions[t.x], positions[t.z] - positions[t.x]);
+				double length = glm::length(normal);
+				if (length == 0.0) continue;
+				normal /= length;
+				// area weighted, large faces constrain their vertices more
+				Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, positions[t.x]), 0.5 * length);
+				for (int j = 0; j < 3; j++) quadrics[t[j]] += q;
+
+				for (int j = 0; j < 3; j++) {
+					uint32_t a = t[j], b = t[(j + 1) % 3];
+					if (!IsBoundaryEdge(a, b)) continue;
+					// plane through the boundary edge, perpendicular to the face, keeps the border from shrinking
+					glm::dvec3 edge = positions[b] - positions[a];
+					glm::dvec3 boundaryNormal = glm::cross(edge, normal);
+					double boundaryLength = glm::length(boundaryNormal);
+					if (boundaryLength == 0.0) continue;
+					boundaryNormal /= boundaryLength;
+					const double boundaryWeight = 10.0;
+					Quadric bq = Quadric::FromPlane(boundaryNormal, -glm::dot(boundaryNormal, positions[a]), boundaryWeight * glm::dot(edge, edge));
+					quadrics[a] += bq;
+					quadrics[b] += bq;
+				}
+			}
+		}
+
+		uint32_t CountEdgeTriangles(uint32_t a, uint32_t b) const {
+			uint32_t count = 0;
+			for (uint32_t t : vertexTriangles[a]) {
+				const glm::uvec3& triangle = triangles[t];
+				count += triangle.x == b || triangle.y == b || triangle.z == b;
+			}
+			return count;
+		}
+
+		bool IsBoundaryEdge(uint32_t a, uint32_t b) const { return CountEdgeTriangles(a, b) == 1; }
+
+		void PushCollapse(uint32_t a, uint32_t b) {
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			glm::dvec3 target;
+			if (!q.Minimize(target)) {
+				// pick the best of the endpoints and the midpoint
+				const glm::dvec3 candidates[3] = { positions[a], positions[b], 0.5 * (positions[a] + positions[b]) };
+				target = candidates[0];
+				for (const glm::dvec3& candidate : candidates) {
+					if (q.Evaluate(candidate) < q.Evaluate(target)) target = candidate;
+				}
+			}
+			heap.push({ std::max(0.0, q.Evaluate(target)), a, b, stamps[a], stamps[b], target });
+		}
+
+		void CollectNeighbors(uint32_t v, std::vector<uint32_t>& out) const {
+			out.clear();
+			for (uint32_t t : vertexTriangles[v]) {
+				for (int j = 0; j < 3; j++) {
+					if (triangles[t][j] != v) out.push_back(triangles[t][j]);
+				}
+			}
+			std::sort(out.begin(), out.end());
+			out.erase(std::unique(out.begin(), out.end()), out.end());
+		}
+
+		bool IsCollapseValid(uint32_t a, uint32_t b, const glm::dvec3& target) {
+			// link condition: the endpoints may only share the vertices opposite to the edge, otherwise the result is non-manifold
+			CollectNeighbors(a, neighborsA);
+			CollectNeighbors(b, neighborsB);
+			sharedNeighbors.clear();
+			std::set_intersection(neighborsA.begin(), neighborsA.end(), neighborsB.begin(), neighborsB.end(), std::back_inserter(sharedNeighbors));
+			if (sharedNeighbors.size() > CountEdgeTriangles(a, b)) return false;
+
+			// triangles that stay must not flip or degenerate
+			for (uint32_t v : { a, b }) {
+				for (uint32_t t : vertexTriangles[v]) {
+					const glm::uvec3& triangle = triangles[t];
+					bool hasA = triangle.x == a || triangle.y == a || triangle.z == a;
+					bool hasB = triangle.x == b || triangle.y == b || triangle.z == b;
+					if (hasA && hasB) continue;
+
+					glm::dvec3 p[3], q[3];
+					for (int j = 0; j < 3; j++) {
+						p[j] = positions[triangle[j]];
+						q[j] = triangle[j] == v ? target : p[j];
+					}
+					glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					double lengths = glm::length(before) * glm::length(after);
+					if (lengths == 0.0 || glm::dot(before, after) < 0.2 * lengths) return false;
+				}
+			}
+			return true;
+		}
+
+		void RemoveTriangleFrom(uint32_t v, uint32_t t) {
+			std::vector<uint32_t>& list = vertexTriangles[v];
+			list.erase(std::find(list.begin(), list.end(), t));
+		}
+
+		void ApplyCollapse(const Collapse& collapse) {
+			const uint32_t a = collapse.a, b = collapse.b;
+			for (uint32_t t : vertexTriangles[b]) {
+				glm::uvec3& triangle = triangles[t];
+				if (triangle.x == a || triangle.y == a || triangle.z == a) {
+					isTriangleRemoved[t] = 1;
+					liveTriangleCount--;
+					for (int j = 0; j < 3; j++) {
+						if (triangle[j] != b) RemoveTriangleFrom(triangle[j], t);
+					}
+				}
+				else {
+					for (int j = 0; j < 3; j++) {
+						if (triangle[j] == b) triangle[j] = a;
+					}
+					vertexTriangles[a].push_back(t);
+				}
+			}
+			vertexTriangles[b].clear();
+			isVertexRemoved[b] = 1;
+			positions[a] = collapse.target;
+			quadrics[a] += quadrics[b];
+			stamps[a]++;
+			maxError = std::max(maxError, collapse.cost);
+
+			CollectNeighbors(a, neighborsA);
+			for (uint32_t n : neighborsA) {
+				PushCollapse(a, n);
+			}
+		}
+	private:
+		std::vector<glm::dvec3> positions;
+		std::vector<glm::uvec3> triangles;
+		std::vector<uint8_t> isTriangleRemoved;
+		std::vector<uint8_t> isVertexRemoved;
+		std::vector<std::vector<uint32_t>> vertexTriangles;
+		std::vector<Quadric> quadrics;
+		std::vector<uint32_t> stamps; // incremented when a vertex changes, invalidates queued collapses of its edges
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+		size_t liveTriangleCount = 0;
+		double maxError = 0.0;
+		std::vector<uint32_t> neighborsA, neighborsB, sharedNeighbors;
+	};
+
+	std::vector<Level> BuildLODChain(const std::vector<glm::vec3>& positions, const std::vector<glm::uvec3>& triangles, float reduction, size_t minTriangles, size_t maxLevels) {
+		std::vector<Level> levels;
+		Simplifier simplifier(positions, triangles);
+		size_t target = (size_t)(simplifier.GetTriangleCount() * reduction);
+		while (levels.size() < maxLevels && target >= minTriangles) {
+			if (!simplifier.Run(target)) break;
+			levels.push_back(simplifier.Snapshot());
+			target = (size_t)(simplifier.GetTriangleCount() * reduction);
+		}
+		return levels;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Triangle mesh simplification by edge collapses ordered by quadric error metrics (Garland & Heckbert 1997).
+// Only positions are considered. Boundary edges are kept in place by additional perpendicular planes.
+namespace MeshSimplifier {
+	struct Level {
+		std::vector<glm::vec3> Positions;
+		std::vector<glm::uvec3> Triangles;
+		float Error = 0.0f; // largest quadric error of the collapses so far, in squared object-space units
+	};
+
+	// Simplifies the mesh progressively and snapshots it whenever the triangle count falls to reduction times the previous level's.
+	// Stops at maxLevels, when a level would have fewer than minTriangles, or when no more edges can be collapsed.
+	// The full resolution mesh is not included.
+	std::vector<Level> BuildLODChain(const std::vector<glm::vec3>& positions, const std::vector<glm::uvec3>& triangles, float reduction = 0.5f, size_t minTriangles = 64, size_t maxLevels = 6);
+}
@@ -0,0 +1,186 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "../ThreadPool.h"
+
+void OcclusionBuffer::Resize(uint32_t width, uint32_t height) {
+	tilesX = std::max(1u, (width + TileWidth - 1) / TileWidth);
+	tilesY = std::max(1u, (height + TileHeight - 1) / TileHeight);
+	tiles.resize((size_t)tilesX * tilesY);
+}
+
+void OcclusionBuffer::Begin(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+	std::fill(tiles.begin(), tiles.end(), Tile{ std::numeric_limits<float>::max(), 0.0f, 0 });
+	occluders.clear();
+	occluderTriangleCount = 0;
+}
+
+void OcclusionBuffer::AddOccluder(const glm::mat4& transform, const void* positions, size_t stride, const glm::uvec3* triangles, size_t triangleCount) {
+	occluders.push_back({ viewProjection * transform, static_cast<const uint8_t*>(positions), stride, triangles, triangleCount });
+}
+
+void OcclusionBuffer::SetupTriangles(const Occluder& occluder, std::vector<ScreenTriangle>& out) const {
+	out.clear();
+	const glm::vec2 screenSize = { (float)GetWidth(), (float)GetHeight() };
+	for (size_t t = 0; t < occluder.triangleCount; t++) {
+		glm::vec3 screen[3];
+		bool isClipped = false;
+		for (int j = 0; j < 3; j++) {
+			const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(occluder.positions + occluder.triangles[t][j] * occluder.stride);
+			glm::vec4 clip = occluder.transform * glm::vec4(position, 1.0f);
+			// triangles crossing the near plane are not clipped but dropped, which only makes the buffer less occluding
+			if (clip.z < -clip.w || clip.w <= 0.0f) {
+				isClipped = true;
+				break;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[j] = { (ndc.x * 0.5f + 0.5f) * screenSize.x, (ndc.y * 0.5f + 0.5f) * screenSize.y, ndc.z };
+		}
+		if (isClipped) continue;
+
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (std::abs(area) < 1e-8f) continue;
+		// both faces occlude, make it counter-clockwise
+		if (area < 0.0f) {
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		glm::vec2 min = glm::min(glm::min(glm::vec2(screen[0]), glm::vec2(screen[1])), glm::vec2(screen[2]));
+		glm::vec2 max = glm::max(glm::max(glm::vec2(screen[0]), glm::vec2(screen[1])), glm::vec2(screen[2]));
+		if (max.x < 0.0f || max.y < 0.0f || min.x >= screenSize.x || min.y >= screenSize.y) continue;
+
+		ScreenTriangle triangle;
+		for (int j = 0; j < 3; j++) {
+			triangle.v[j] = glm::vec2(screen[j]);
+		}
+		const glm::vec3 d1 = screen[1] - screen[0];
+		const glm::vec3 d2 = screen[2] - screen[0];
+		triangle.zPlane.x = (d1.z * d2.y - d2.z * d1.y) / area;
+		triangle.zPlane.y = (d2.z * d1.x - d1.z * d2.x) / area;
+		triangle.zPlane.z = screen[0].z - triangle.zPlane.x * screen[0].x - triangle.zPlane.y * screen[0].y;
+		triangle.zMin = std::min({ screen[0].z, screen[1].z, screen[2].z });
+		triangle.zMax = std::max({ screen[0].z, screen[1].z, screen[2].z });
+		triangle.tileBounds = {
+			std::max(0, (int)(min.x / TileWidth)),
+			std::max(0, (int)(min.y / TileHeight)),
+			std::min((int)tilesX - 1, (int)(max.x / TileWidth)),
+			std::min((int)tilesY - 1, (int)(max.y / TileHeight)),
+		};
+		out.push_back(triangle);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const ScreenTriangle& triangle, uint32_t tileRowBegin, uint32_t tileRowEnd) {
+	// edge functions a * x + b * y + c, non-negative inside
+	float a[3], b[3], c[3];
+	for (int i = 0; i < 3; i++) {
+		const glm::vec2& p = triangle.v[i];
+		const glm::vec2& q = triangle.v[(i + 1) % 3];
+		a[i] = p.y - q.y;
+		b[i] = q.x - p.x;
+		c[i] = -(a[i] * p.x + b[i] * p.y);
+	}
+
+	const int rowBegin = std::max(triangle.tileBounds.y, (int)tileRowBegin);
+	const int rowEnd = std::min(triangle.tileBounds.w + 1, (int)tileRowEnd);
+	for (int ty = rowBegin; ty < rowEnd; ty++) {
+		for (int tx = triangle.tileBounds.x; tx <= triangle.tileBounds.z; tx++) {
+			Tile& tile = tiles[(size_t)ty * tilesX + tx];
+			if (triangle.zMin >= tile.zMax0) continue;
+
+			// sample pixel centers, one bit per pixel. Branchless so that the compiler can vectorize it.
+			const float x0 = (float)(tx * TileWidth) + 0.5f;
+			const float y0 = (float)(ty * TileHeight) + 0.5f;
+			uint32_t coverage = 0;
+			for (uint32_t bit = 0; bit < TileWidth * TileHeight; bit++) {
+				float x = x0 + (float)(bit % TileWidth);
+				float y = y0 + (float)(bit / TileWidth);
+				bool isInside = (a[0] * x + b[0] * y + c[0] >= 0.0f) & (a[1] * x + b[1] * y + c[1] >= 0.0f) & (a[2] * x + b[2] * y + c[2] >= 0.0f);
+				coverage |= (uint32_t)isInside << bit;
+			}
+			if (coverage == 0) continue;
+
+			// farthest depth of the triangle within the tile, from the plane at the corner samples
+			const float x1 = x0 + (float)(TileWidth - 1);
+			const float y1 = y0 + (float)(TileHeight - 1);
+			const glm::vec3& plane = triangle.zPlane;
+			float zCorners = std::max(std::max(plane.x * x0 + plane.y * y0, plane.x * x1 + plane.y * y0), std::max(plane.x * x0 + plane.y * y1, plane.x * x1 + plane.y * y1)) + plane.z;
+			float zTriangle = std::min(zCorners, triangle.zMax);
+
+			// Merge into the working layer, or discard the layer for a much closer triangle. As in the paper, the triangle's
+			// distance to the layer (zMax1 - zTriangle) is weighed against what the layer gained over the tile's depth
+			// (zMax0 - zMax1). Measuring the triangle from zMax0 instead would discard the layer for any closer triangle, so
+			// a layer built from triangles at slightly different depths, e.g. of a tilted or curved surface, would keep
+			// restarting and rarely cover the whole tile.
+			if (tile.mask != 0 && tile.zMax1 - zTriangle > tile.zMax0 - tile.zMax1) {
+				tile.mask = 0;
+			}
+			tile.zMax1 = tile.mask == 0 ? zTriangle : std::max(tile.zMax1, zTriangle);
+			tile.mask |= coverage;
+			// a fully covered working layer becomes the tile's depth
+			if (tile.mask == ~0u) {
+				tile.zMax0 = std::min(tile.zMax0, tile.zMax1);
+				tile.mask = 0;
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::Rasterize() {
+	ThreadPool& pool = ThreadPool::Instance();
+	occluderTriangles.resize(occluders.size());
+	pool.ParallelFor((uint32_t)occluders.size(), [&](uint32_t i) {
+		SetupTriangles(occluders[i], occluderTriangles[i]);
+	});
+	occluderTriangleCount = 0;
+	for (const auto& triangles : occluderTriangles) {
+		occluderTriangleCount += (uint32_t)triangles.size();
+	}
+
+	// each band of tile rows is owned by one job, all jobs go over all triangles in the same order
+	const uint32_t numBands = std::min(tilesY, 2 * pool.GetThreadCount());
+	pool.ParallelFor(numBands, [&](uint32_t band) {
+		uint32_t rowBegin = band * tilesY / numBands;
+		uint32_t rowEnd = (band + 1) * tilesY / numBands;
+		for (size_t i = 0; i < occluders.size(); i++) {
+			for (const ScreenTriangle& triangle : occluderTriangles[i]) {
+				if (triangle.tileBounds.w < (int)rowBegin || triangle.tileBounds.y >= (int)rowEnd) continue;
+				RasterizeTriangle(triangle, rowBegin, rowEnd);
+			}
+		}
+	});
+}
+
+bool OcclusionBuffer::IsVisible(const glm::vec3& min, const glm::vec3& max) const {
+	glm::vec2 screenMin{ std::numeric_limits<float>::max() };
+	glm::vec2 screenMax{ -std::numeric_limits<float>::max() };
+	float zMin = std::numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 p = { corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z };
+		glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+		// crosses the near plane, it may cover the whole screen
+		if (clip.z < -clip.w || clip.w <= 0.0f) return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 screen = { (ndc.x * 0.5f + 0.5f) * GetWidth(), (ndc.y * 0.5f + 0.5f) * GetHeight() };
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		zMin = std::min(zMin, ndc.z);
+	}
+
+	const int minX = std::max(0, (int)std::floor(screenMin.x / TileWidth));
+	const int minY = std::max(0, (int)std::floor(screenMin.y / TileHeight));
+	const int maxX = std::min((int)tilesX - 1, (int)std::floor(screenMax.x / TileWidth));
+	const int maxY = std::min((int)tilesY - 1, (int)std::floor(screenMax.y / TileHeight));
+	if (minX > maxX || minY > maxY) return true;
+
+	for (int ty = minY; ty <= maxY; ty++) {
+		for (int tx = minX; tx <= maxX; tx++) {
+			if (tiles[(size_t)ty * tilesX + tx].zMax0 >= zMin) return true;
+		}
+	}
+	return false;
+}
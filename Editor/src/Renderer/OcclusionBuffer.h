@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Low resolution depth buffer rasterized on the CPU from a few large occluders, used to skip meshes hidden behind them.
+// Follows Masked Software Occlusion Culling: tiles of 8x4 pixels keep a conservative far depth plus a working layer
+// made of a 32-bit coverage mask and its farthest depth, instead of per-pixel depths.
+// Depths are NDC z, larger is farther. Runs entirely on the CPU, rows of tiles are rasterized in parallel.
+class OcclusionBuffer {
+public:
+	static const uint32_t TileWidth = 8;
+	static const uint32_t TileHeight = 4;
+
+	struct Tile {
+		float zMax0; // every pixel of the tile is at least this close
+		float zMax1; // every pixel covered by mask is at least this close
+		uint32_t mask; // bit x + y * TileWidth for pixel (x, y) of the tile
+	};
+
+	// Size in pixels is rounded up to whole tiles
+	void Resize(uint32_t width, uint32_t height);
+	// Clears the buffer and the occluder list
+	void Begin(const glm::mat4& viewProjection);
+	// positions are read with the given byte stride. The arrays have to live until Rasterize is called.
+	void AddOccluder(const glm::mat4& transform, const void* positions, size_t stride, const glm::uvec3* triangles, size_t triangleCount);
+	void Rasterize();
+	// Whether a world-space box may be visible, false only when it is entirely behind the rasterized occluders
+	bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+	uint32_t GetWidth() const { return tilesX * TileWidth; }
+	uint32_t GetHeight() const { return tilesY * TileHeight; }
+	const std::vector<Tile>& GetTiles() const { return tiles; }
+	uint32_t GetOccluderTriangleCount() const { return occluderTriangleCount; }
+private:
+	struct Occluder {
+		glm::mat4 transform;
+		const uint8_t* positions;
+		size_t stride;
+		const glm::uvec3* triangles;
+		size_t triangleCount;
+	};
+	// screen-space triangle, counter-clockwise, with its depth plane z = zPlane.x * x + zPlane.y * y + zPlane.z
+	struct ScreenTriangle {
+		glm::vec2 v[3];
+		glm::vec3 zPlane;
+		float zMin, zMax;
+		glm::ivec4 tileBounds; // min x, min y, max x, max y in tiles, inclusive
+	};
+	void SetupTriangles(const Occluder& occluder, std::vector<ScreenTriangle>& out) const;
+	void RasterizeTriangle(const ScreenTriangle& triangle, uint32_t tileRowBegin, uint32_t tileRowEnd);
+private:
+	uint32_t tilesX = 0, tilesY = 0;
+	std::vector<Tile> tiles;
+	glm::mat4 viewProjection{ 1.0f };
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<ScreenTriangle>> occluderTriangles; // per occluder
+	uint32_t occluderTriangleCount = 0;
+};
@@ -1,6 +1,8 @@
 #include "RenderCommand.h"
 
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 
 #include <GLFW/glfw3.h>
 #include <stb/stb_image_write.h>
@@ -9,6 +11,49 @@ FrameStats RenderCommand::frameStats = {};
 bool RenderCommand::shouldDebugRenderSingleFrame = false;
 static int drawCallNo;
 
+// Values GL has, as last set through RenderCommand. ~0u stands for unknown.
+struct GLState {
+	std::unordered_map<GLenum, bool> capabilities;
+	int depthMask = -1;
+	GLenum blendSource = ~0u;
+	GLenum blendDestination = ~0u;
+	GLenum polygonMode = ~0u;
+	float lineWidth = -1.0f;
+	uint32_t program = ~0u;
+	uint32_t vertexArray = ~0u;
+	uint32_t framebuffer = 0;
+	glm::uvec4 viewport = glm::uvec4(~0u);
+	std::unordered_map<uint32_t, uint32_t> textureUnits;
+	std::unordered_map<uint32_t, bool> colorMasks; // by draw buffer
+	bool isDefaultColorSet = false;
+};
+static GLState glState;
+
+static const uint32_t ColorAttribute = 2;
+
+// Vertex arrays without a color attribute (location 2) read a constant value, set to no tint. GL leaves it undefined
+// after drawing with the attribute's array enabled, so it is set again before the next draw without one.
+static void UpdateDefaultColor(bool hasColorAttribute) {
+	if (hasColorAttribute) {
+		glState.isDefaultColorSet = false;
+	}
+	else if (!glState.isDefaultColorSet) {
+		glVertexAttrib4f(ColorAttribute, 1.0f, 1.0f, 1.0f, 1.0f);
+		glState.isDefaultColorSet = true;
+	}
+}
+
+// Stores value into state and returns true when it changed, otherwise counts a skipped change
+template<typename T>
+static bool Change(T& state, const T& value) {
+	if (state == value) {
+		RenderCommand::frameStats.redundantStateChanges++;
+		return false;
+	}
+	state = value;
+	return true;
+}
+
 void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
 	if (severity == GL_DEBUG_SEVERITY_LOW || severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
 	fprintf(stderr, "GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
@@ -16,36 +61,38 @@ void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum se
 		type, severity, message);
 }
 
-void RenderCommand::Init(bool isWireframe, bool onlyFrontFaces) {
+void RenderCommand::Init() {
 	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(MessageCallback, 0);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	//glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
 	//glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_DEPTH_TEST);
+	glCullFace(GL_BACK);
+	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+
+	glState = {};
+	// separates the strips of the line batch, never reached by other indices
+	SetCapability(GL_PRIMITIVE_RESTART_FIXED_INDEX, true);
+	BeginFrame();
+}
 
+void RenderCommand::BeginFrame(bool isWireframe, bool onlyFrontFaces) {
+	SetCapability(GL_BLEND, true);
+	SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	SetCapability(GL_DEPTH_TEST, true);
+	SetDepthMask(true);
+
+	SetPolygonMode(isWireframe ? GL_LINE : GL_FILL);
+	SetCapability(GL_LINE_SMOOTH, isWireframe); // anti-aliasing
 	if (isWireframe) {
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glEnable(GL_LINE_SMOOTH); // anti-aliasing
-		glLineWidth(2.0f);
-		glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-	}
-	else {
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	}
-	if (onlyFrontFaces) {
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-	}
-	else {
-		glDisable(GL_CULL_FACE);
+		SetLineWidth(2.0f);
 	}
+	SetCapability(GL_CULL_FACE, onlyFrontFaces);
+	glState.isDefaultColorSet = false; // code outside RenderCommand, e.g. ImGui, may have drawn with it
 
-	frameStats = { 0, 0, 0 };
+	frameStats = {};
 	drawCallNo = 1;
 }
 
@@ -61,26 +108,13 @@ void RenderCommand::SetClearColor(const glm::vec4& color) {
 }
 
 void RenderCommand::Clear() {
-	glDepthMask(GL_TRUE); // when not set true depth buffer won't be cleaned
+	SetDepthMask(true); // when not set true depth buffer won't be cleaned
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void RenderCommand::DrawIndexed(const std::shared_ptr<VertexArray>& vertexArray, uint32_t indexCount, GLenum primitiveType, uint32_t indexOffset) {
-	uint32_t count = indexCount ? indexCount : vertexArray->GetIndexBuffer()->GetCount();
-	glDrawElements(primitiveType, count, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * indexOffset));
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	// Collect Frame Render Stats
-	frameStats.drawCalls += 1;
-	if (primitiveType == GL_TRIANGLES) {
-		frameStats.triangles += count / 3;
-	}
-	if (primitiveType == GL_LINE_LOOP || primitiveType == GL_LINE_STRIP) {
-		frameStats.lines += count;
-	}
-
-	// Save Framebuffer to a file after each draw call 
-	if (shouldDebugRenderSingleFrame) {
+// Saves the framebuffer to a file after each draw call of the frame being debugged
+static void SaveDrawCall() {
+	if (RenderCommand::shouldDebugRenderSingleFrame) {
 		// Bound Framebuffer Size
 		GLint dims[4] = { 0 };
 		glGetIntegerv(GL_VIEWPORT, dims);
@@ -106,6 +140,164 @@ void RenderCommand::DrawIndexed(const std::shared_ptr<VertexArray>& vertexArray,
 	}
 }
 
+void RenderCommand::DrawIndexed(const std::shared_ptr<VertexArray>& vertexArray, uint32_t indexCount, GLenum primitiveType, uint32_t indexOffset) {
+	uint32_t count = indexCount ? indexCount : vertexArray->GetIndexBuffer()->GetCount();
+	UpdateDefaultColor(vertexArray->GetAttributeCount() > ColorAttribute);
+	glDrawElements(primitiveType, count, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * indexOffset));
+
+	// Collect Frame Render Stats
+	frameStats.drawCalls += 1;
+	if (primitiveType == GL_TRIANGLES) {
+		frameStats.triangles += count / 3;
+	}
+	if (primitiveType == GL_LINE_LOOP || primitiveType == GL_LINE_STRIP) {
+		frameStats.lines += count;
+	}
+
+	SaveDrawCall();
+}
+
+void RenderCommand::MultiDrawIndexedIndirect(uint32_t drawCount, uint32_t indirectOffset, uint32_t triangleCount, GLenum primitiveType) {
+	UpdateDefaultColor(true); // the arena's vertex array has per-instance colors
+	glMultiDrawElementsIndirect(primitiveType, GL_UNSIGNED_INT, (const void*)(size_t)indirectOffset, (GLsizei)drawCount, 0);
+
+	frameStats.drawCalls += 1;
+	frameStats.triangles += triangleCount;
+	SaveDrawCall();
+}
+
+void RenderCommand::DrawArrays(const std::shared_ptr<VertexArray>& vertexArray, uint32_t vertexCount, GLenum primitiveType) {
+	vertexArray->Bind();
+	UpdateDefaultColor(vertexArray->GetAttributeCount() > ColorAttribute);
+	glDrawArrays(primitiveType, 0, vertexCount);
+
+	frameStats.drawCalls += 1;
+	if (primitiveType == GL_TRIANGLES) {
+		frameStats.triangles += vertexCount / 3;
+	}
+}
+
 void RenderCommand::SetViewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-	glViewport(x, y, width, height);
+	if (Change(glState.viewport, glm::uvec4(x, y, width, height))) {
+		glViewport(x, y, width, height);
+	}
+}
+
+void RenderCommand::SetCapability(GLenum capability, bool isEnabled) {
+	auto it = glState.capabilities.find(capability);
+	if (it != glState.capabilities.end() && !Change(it->second, isEnabled)) return;
+	glState.capabilities[capability] = isEnabled;
+	if (isEnabled) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+}
+
+void RenderCommand::SetDepthMask(bool isWritten) {
+	if (Change(glState.depthMask, (int)isWritten)) {
+		glDepthMask(isWritten ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void RenderCommand::SetBlendFunc(GLenum source, GLenum destination) {
+	if (glState.blendSource == source && glState.blendDestination == destination) {
+		frameStats.redundantStateChanges++;
+		return;
+	}
+	glState.blendSource = source;
+	glState.blendDestination = destination;
+	glBlendFunc(source, destination);
+}
+
+void RenderCommand::SetBlendFunc(uint32_t drawBuffer, GLenum source, GLenum destination) {
+	glState.blendSource = ~0u;
+	glState.blendDestination = ~0u;
+	glBlendFunci(drawBuffer, source, destination);
+}
+
+void RenderCommand::SetColorMask(uint32_t drawBuffer, bool isWritten) {
+	auto it = glState.colorMasks.find(drawBuffer);
+	if (it != glState.colorMasks.end() && !Change(it->second, isWritten)) return;
+	glState.colorMasks[drawBuffer] = isWritten;
+	glColorMaski(drawBuffer, isWritten, isWritten, isWritten, isWritten);
+}
+
+void RenderCommand::SetPolygonMode(GLenum mode) {
+	if (Change(glState.polygonMode, mode)) {
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+}
+
+void RenderCommand::SetLineWidth(float width) {
+	if (Change(glState.lineWidth, width)) {
+		glLineWidth(width);
+	}
+}
+
+void RenderCommand::UseProgram(uint32_t program) {
+	if (Change(glState.program, program)) {
+		glUseProgram(program);
+		frameStats.shaderBinds++;
+	}
+}
+
+void RenderCommand::BindVertexArray(uint32_t vertexArray) {
+	if (Change(glState.vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+		frameStats.vertexArrayBinds++;
+	}
+}
+
+void RenderCommand::BindFramebuffer(uint32_t framebuffer) {
+	if (Change(glState.framebuffer, framebuffer)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void RenderCommand::BindTextureUnit(uint32_t unit, uint32_t texture) {
+	auto it = glState.textureUnits.find(unit);
+	if (it != glState.textureUnits.end() && !Change(it->second, texture)) return;
+	glState.textureUnits[unit] = texture;
+	glBindTextureUnit(unit, texture);
+}
+
+uint32_t RenderCommand::GetBoundFramebuffer() {
+	return glState.framebuffer;
+}
+
+glm::uvec4 RenderCommand::GetViewport() {
+	if (glState.viewport == glm::uvec4(~0u)) {
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glState.viewport = glm::uvec4(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+	return glState.viewport;
+}
+
+void RenderCommand::OnVertexArrayDeleted(uint32_t vertexArray) {
+	if (glState.vertexArray == vertexArray) {
+		glState.vertexArray = 0;
+	}
+}
+
+void RenderCommand::OnProgramDeleted(uint32_t program) {
+	if (glState.program == program) {
+		glState.program = 0;
+	}
+}
+
+void RenderCommand::OnFramebufferDeleted(uint32_t framebuffer) {
+	if (glState.framebuffer == framebuffer) {
+		glState.framebuffer = 0;
+	}
+}
+
+void RenderCommand::OnTexturesDeleted(const uint32_t* textures, uint32_t count) {
+	for (auto& [unit, texture] : glState.textureUnits) {
+		if (std::find(textures, textures + count, texture) != textures + count) {
+			texture = 0;
+		}
+	}
 }
\ No newline at end of file
@@ -10,17 +10,60 @@ struct FrameStats {
 	int drawCalls = 0;
 	int triangles = 0;
 	int lines = 0;
+	int visibleMeshes = 0;
+	int culledMeshes = 0; // outside the view frustum
+	int occludedMeshes = 0;
+	int trianglesSavedByLOD = 0;
+	int shaderBinds = 0;
+	int vertexArrayBinds = 0;
+	int multiDrawnMeshes = 0; // drawn from the geometry arena by multi-draws
+	// per-frame data streamed through ring buffers, bytes written out of the bytes available per frame
+	uint32_t ringBytes = 0;
+	uint32_t ringCapacity = 0;
+	int ringStalls = 0; // waits for the GPU to release a ring buffer part
+	int redundantStateChanges = 0; // state changes and binds skipped because GL already had the value
 };
 
+// GL calls go through RenderCommand. It keeps a copy of the GL state it has set, so that setting a value GL
+// already has is skipped. Code calling GL directly for these states has to keep the copy in sync.
 class RenderCommand {
 public:
-	static void Init(bool isWireframe = false, bool onlyFrontFaces = false);
+	// Loads GL and sets the state that never changes. Called once, after the context is created.
+	static void Init();
+	// Pipeline state of a frame's scene rendering, and resets the stats
+	static void BeginFrame(bool isWireframe = false, bool onlyFrontFaces = false);
 	static void PrintInfo();
 	static void SetClearColor(const glm::vec4& color);
 	static void Clear();
 	static void DrawIndexed(const std::shared_ptr<VertexArray>& vertexArray, uint32_t indexCount = 0, GLenum primitiveType = GL_TRIANGLES, uint32_t indexOffset = 0);
+	// Draws drawCount commands at byte indirectOffset of the bound GL_DRAW_INDIRECT_BUFFER. triangleCount is only counted in the stats.
+	static void MultiDrawIndexedIndirect(uint32_t drawCount, uint32_t indirectOffset, uint32_t triangleCount, GLenum primitiveType = GL_TRIANGLES);
+	// Draws vertices without an index buffer, e.g. full-screen passes that generate positions from gl_VertexID
+	static void DrawArrays(const std::shared_ptr<VertexArray>& vertexArray, uint32_t vertexCount, GLenum primitiveType = GL_TRIANGLES);
 	static void SetViewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 	static const FrameStats& GetStats() { return frameStats; }
+
+	// Tracked state
+	static void SetCapability(GLenum capability, bool isEnabled);
+	static void SetDepthMask(bool isWritten);
+	static void SetBlendFunc(GLenum source, GLenum destination);
+	// Blend function of one draw buffer. The function of all buffers is unknown afterwards.
+	static void SetBlendFunc(uint32_t drawBuffer, GLenum source, GLenum destination);
+	// Whether draws write to one draw buffer
+	static void SetColorMask(uint32_t drawBuffer, bool isWritten);
+	static void SetPolygonMode(GLenum mode);
+	static void SetLineWidth(float width);
+	static void UseProgram(uint32_t program);
+	static void BindVertexArray(uint32_t vertexArray);
+	static void BindFramebuffer(uint32_t framebuffer);
+	static void BindTextureUnit(uint32_t unit, uint32_t texture);
+	static uint32_t GetBoundFramebuffer();
+	static glm::uvec4 GetViewport();
+	// Deleting bound objects unbinds them, and their names can be reused. Called before deleting them.
+	static void OnVertexArrayDeleted(uint32_t vertexArray);
+	static void OnProgramDeleted(uint32_t program);
+	static void OnFramebufferDeleted(uint32_t framebuffer);
+	static void OnTexturesDeleted(const uint32_t* textures, uint32_t count);
 public:
 	static FrameStats frameStats;
 	static bool shouldDebugRenderSingleFrame;
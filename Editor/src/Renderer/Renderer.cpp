@@ -1,51 +1,232 @@
 #include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
 
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Renderer.h"
+#include "Framebuffer.h"
+#include "GeometryArena.h"
 #include "RenderCommand.h"
+#include "RingBuffer.h"
 #include "Shader.h"
+#include "../Math.h"
 
 // Hard-coded data for Renderer to provide ready-made draw commands such as DrawFlatQuad
 struct RendererData {
+	glm::mat4 projection;
 	glm::mat4 viewProj;
-	std::vector<Renderer::LightInfo> lightInfos;
+	glm::vec3 cameraPosition;
+	std::shared_ptr<Shader> lineShader;
+
+	// std140 mirrors of the Camera and Lights blocks in the shaders
+	struct CameraUniforms {
+		glm::mat4 viewProjection;
+		glm::vec4 cameraPosition;
+	};
+	struct LightUniforms {
+		glm::vec4 viewDepth; // dot with a world position gives its view depth
+		glm::vec4 clusterDepth; // LightClusters' slice near and scale
+		glm::uvec4 clusterCount; // tiles across x and y, depth slices
+	};
+	std::shared_ptr<UniformBuffer> cameraUniformBuffer;
+	std::shared_ptr<UniformBuffer> lightUniformBuffer;
+
+	// Clustered lights. Lights, clusters and cluster light indices are written into the ring each frame.
+	LightClusters lightClusters;
+	std::vector<LightClusters::Light> lights;
+	std::unique_ptr<RingBuffer<ShaderStorageBuffer>> lightClusterRing;
+	uint32_t storageBufferAlignment = 0;
+
+	// Mesh shaders are drawn with their INSTANCED variant in multi-draws
+	std::unordered_map<const Shader*, std::shared_ptr<Shader>> shaderVariants[2]; // not instanced, instanced
+
+	// Draws of the frame, executed in the order of their keys with redundant binds skipped
+	std::vector<Renderer::DrawCommand> drawQueue;
+	std::vector<std::pair<uint64_t, uint32_t>> drawOrder; // key, index into drawQueue
+
+	// Opaque meshes are drawn from the GeometryArena, one glMultiDrawElementsIndirect per shader.
+	// Meshes with the same geometry become instances of one indirect command. Per-instance attributes
+	// are found through the command's base instance.
+	struct InstanceData {
+		int32_t entityID;
+		glm::vec4 color;
+		glm::mat4 transform;
+	};
+	bool isMultiDrawEnabled = true;
+	std::shared_ptr<VertexArray> arenaVertexArray; // arena buffers and the instance ring
+	uint32_t arenaGeneration = 0;
+	uint32_t instanceRingGeneration = 0;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> instanceGroups; // geometry hash to draw indices, for the shader being drawn
+	std::vector<uint64_t> instanceGroupOrder; // hashes in the order of their nearest draw
+	// the multi-draw built by BuildMultiDraw, its commands are at indirectOffset in the indirect ring
+	uint32_t indirectCount = 0;
+	uint32_t indirectOffset = 0;
+	uint32_t multiDrawTriangles = 0;
+	uint32_t multiDrawInstances = 0;
+
+	// Per-frame data is written straight into persistently mapped buffers
+	std::unique_ptr<RingBuffer<VertexBuffer>> instanceRing;
+	std::unique_ptr<RingBuffer<DrawIndirectBuffer>> indirectRing;
+	std::unique_ptr<RingBuffer<VertexBuffer>> transparentVertexRing;
+	std::unique_ptr<RingBuffer<IndexBuffer>> transparentIndexRing;
+
+	// Transparent batch. Rebuilt every frame from the submitted meshes.
+	std::vector<Renderer::TransparentVertex> transparentVertices;
+	std::vector<uint32_t> transparentMeshIndices; // unsorted, offset into transparentVertices
+	// Sort items are either single triangles or whole BSP meshes whose triangles are already ordered
+	std::vector<float> transparentItemDistances;
+	std::vector<glm::uvec2> transparentItemTriangles; // first triangle, triangle count
+	std::vector<uint32_t> bspOrder;
+	TransparencySorter transparencySorter;
+	std::shared_ptr<VertexArray> transparentVertexArray; // transparent rings, rebuilt when they grow
+	uint32_t transparentRingGenerations = 0;
+
+	// Line batch. Polylines are transformed into the line rings when the draw queue is executed,
+	// and drawn as one line strip with the restart index between them.
+	struct LineStrip {
+		const std::vector<glm::vec3>* vertices;
+		glm::mat4 transform;
+		glm::vec4 color;
+		bool isLooped;
+		int entityID;
+	};
+	std::vector<LineStrip> lineStrips;
+	std::unique_ptr<RingBuffer<VertexBuffer>> lineVertexRing;
+	std::unique_ptr<RingBuffer<IndexBuffer>> lineIndexRing;
+	std::shared_ptr<VertexArray> lineVertexArray;
+	uint32_t lineRingGenerations = 0;
+	Renderer::TransparencyMode transparencyMode = Renderer::TransparencyMode::SortedTriangles;
+
+	// Weighted Blended OIT targets: accumulation, revealage, entity ID and a copy of the scene depth. Sized lazily to the viewport.
+	std::shared_ptr<Framebuffer> oitFramebuffer;
+	// has no buffers, for passes that generate vertices in the shader
+	std::shared_ptr<VertexArray> emptyVertexArray;
 };
 static RendererData rendererData;
 
 void Renderer::Init() {
 	RenderCommand::Init();
+	ShaderCompiler::Instance().Init();
+
+	rendererData.emptyVertexArray = std::make_shared<VertexArray>();
+
+	static_assert(sizeof(RendererData::InstanceData) == 4 + 16 + 64, "InstanceData has to match the instance buffer layout");
+	rendererData.instanceRing = std::make_unique<RingBuffer<VertexBuffer>>(1 << 20);
+	rendererData.indirectRing = std::make_unique<RingBuffer<DrawIndirectBuffer>>(1 << 16);
+	rendererData.transparentVertexRing = std::make_unique<RingBuffer<VertexBuffer>>(1 << 20);
+	rendererData.transparentIndexRing = std::make_unique<RingBuffer<IndexBuffer>>(1 << 20);
+	rendererData.lineVertexRing = std::make_unique<RingBuffer<VertexBuffer>>(1 << 18);
+	rendererData.lineIndexRing = std::make_unique<RingBuffer<IndexBuffer>>(1 << 16);
+	rendererData.lightClusterRing = std::make_unique<RingBuffer<ShaderStorageBuffer>>(1 << 20);
+	GLint storageBufferAlignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferAlignment);
+	rendererData.storageBufferAlignment = std::max(storageBufferAlignment, 16);
+
+	rendererData.cameraUniformBuffer = std::make_shared<UniformBuffer>((uint32_t)sizeof(RendererData::CameraUniforms), CameraBinding);
+	rendererData.lightUniformBuffer = std::make_shared<UniformBuffer>((uint32_t)sizeof(RendererData::LightUniforms), LightsBinding);
 }
 
-void Renderer::BeginScene(const Camera& camera, const glm::mat4& cameraTransform, const std::vector<Renderer::LightInfo>& lightInfos) {
-	rendererData.viewProj = camera.GetProjection() * glm::inverse(cameraTransform);
-	if (lightInfos.empty()) {
-		rendererData.lightInfos = { { {0, 0, 0}, 0.0f } };
-	}
-	else {
-		rendererData.lightInfos = lightInfos;
+// Assigns the lights to clusters and writes them, the clusters and the clusters' light indices into the light cluster ring
+static void UploadLightClusters(const glm::mat4& view, const std::vector<Renderer::LightInfo>& lightInfos) {
+	std::vector<LightClusters::Light>& lights = rendererData.lights;
+	lights.resize(lightInfos.size());
+	for (size_t i = 0; i < lightInfos.size(); i++) {
+		lights[i] = { glm::vec4(lightInfos[i].position, lightInfos[i].intensity), lightInfos[i].range, { 0.0f, 0.0f, 0.0f } };
 	}
+	LightClusters& lightClusters = rendererData.lightClusters;
+	lightClusters.Assign(lights, view, rendererData.projection);
+
+	RendererData::LightUniforms lightUniforms = {
+		-glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]), // view space looks down -z
+		glm::vec4(lightClusters.GetSliceNear(), lightClusters.GetSliceScale(), 0.0f, 0.0f),
+		glm::uvec4(LightClusters::TileCountX, LightClusters::TileCountY, LightClusters::SliceCount, 0),
+	};
+	rendererData.lightUniformBuffer->SetData(&lightUniforms, sizeof(lightUniforms));
+
+	// One allocation for the three blocks, so that they are in the same buffer when the ring grows.
+	// Blocks without data still get a range, as binding an empty range is an error.
+	const std::vector<LightClusters::Cluster>& clusters = lightClusters.GetClusters();
+	const std::vector<uint32_t>& lightIndices = lightClusters.GetLightIndices();
+	const uint32_t alignment = rendererData.storageBufferAlignment;
+	auto alignedSize = [alignment](size_t size) { return (uint32_t)((std::max(size, (size_t)16) + alignment - 1) / alignment * alignment); };
+	const uint32_t lightsSize = alignedSize(sizeof(LightClusters::Light) * lights.size());
+	const uint32_t clustersSize = alignedSize(sizeof(LightClusters::Cluster) * clusters.size());
+	const uint32_t lightIndicesSize = alignedSize(sizeof(uint32_t) * lightIndices.size());
+	uint32_t offset;
+	uint8_t* destination = static_cast<uint8_t*>(rendererData.lightClusterRing->Allocate(lightsSize + clustersSize + lightIndicesSize, alignment, offset));
+	std::memcpy(destination, lights.data(), sizeof(LightClusters::Light) * lights.size());
+	std::memcpy(destination + lightsSize, clusters.data(), sizeof(LightClusters::Cluster) * clusters.size());
+	std::memcpy(destination + lightsSize + clustersSize, lightIndices.data(), sizeof(uint32_t) * lightIndices.size());
+
+	const ShaderStorageBuffer& buffer = *rendererData.lightClusterRing->GetBuffer();
+	buffer.BindRange(Renderer::PointLightsBinding, offset, lightsSize);
+	buffer.BindRange(Renderer::LightClustersBinding, offset + lightsSize, clustersSize);
+	buffer.BindRange(Renderer::ClusterLightIndicesBinding, offset + lightsSize + clustersSize, lightIndicesSize);
+}
+
+void Renderer::BeginScene(const Camera& camera, const glm::mat4& cameraTransform, const std::vector<Renderer::LightInfo>& lightInfos) {
+	const glm::mat4 view = glm::inverse(cameraTransform);
+	rendererData.projection = camera.GetProjection();
+	rendererData.viewProj = camera.GetProjection() * view;
+	rendererData.cameraPosition = glm::vec3(cameraTransform[3]);
+
+	RendererData::CameraUniforms cameraUniforms = { rendererData.viewProj, glm::vec4(rendererData.cameraPosition, 1.0f) };
+	rendererData.cameraUniformBuffer->SetData(&cameraUniforms, sizeof(cameraUniforms));
+	rendererData.lineShader = ShaderLibrary::Instance().Get("SolidColor");
+	rendererData.drawQueue.clear();
+
+	rendererData.instanceRing->BeginFrame();
+	rendererData.indirectRing->BeginFrame();
+	rendererData.transparentVertexRing->BeginFrame();
+	rendererData.transparentIndexRing->BeginFrame();
+	rendererData.lineVertexRing->BeginFrame();
+	rendererData.lineIndexRing->BeginFrame();
+	rendererData.lightClusterRing->BeginFrame();
+	UploadLightClusters(view, lightInfos);
 }
 
 void Renderer::EndScene() {
+	ExecuteDrawQueue();
+	GeometryArena::Instance().EndFrame();
 
+	rendererData.instanceRing->EndFrame();
+	rendererData.indirectRing->EndFrame();
+	rendererData.transparentVertexRing->EndFrame();
+	rendererData.transparentIndexRing->EndFrame();
+	rendererData.lineVertexRing->EndFrame();
+	rendererData.lineIndexRing->EndFrame();
+	rendererData.lightClusterRing->EndFrame();
 }
 
-void Renderer::Submit(const std::shared_ptr<Shader> shader, const std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, GLenum primitiveType, uint32_t indexOffset, uint32_t indexCount) {
-	shader->Bind();
-	shader->UploadUniformMat4("u_ViewProjection", rendererData.viewProj);
-	shader->UploadUniformMat4("u_Transform", transform); // ModelMatrix
+const glm::mat4& Renderer::GetProjection() {
+	return rendererData.projection;
+}
 
-	std::vector<glm::vec3> lightPositions;
-	std::transform(rendererData.lightInfos.begin(), rendererData.lightInfos.end(),
-		std::back_inserter(lightPositions), [](LightInfo li) -> glm::vec3 { return li.position; });
-	std::vector<float> lightIntensities;
-	std::transform(rendererData.lightInfos.begin(), rendererData.lightInfos.end(),
-		std::back_inserter(lightIntensities), [](LightInfo li) -> float { return li.intensity; });
+const glm::mat4& Renderer::GetViewProjection() {
+	return rendererData.viewProj;
+}
+
+const glm::vec3& Renderer::GetCameraPosition() {
+	return rendererData.cameraPosition;
+}
 
-	shader->UploadUniformFloat3s("u_LightPositions", lightPositions);
-	shader->UploadUniformFloats("u_LightIntensities", lightIntensities);
-	shader->UploadUniformInt("u_LightCount", rendererData.lightInfos.size());
+static const UniformID TransformUniform("u_Transform");
+static const UniformID ColorUniform("u_Color");
+
+// Variant of shader to draw with, mesh shaders take their transforms from instance attributes in multi-draws
+static const std::shared_ptr<Shader>& GetShaderVariant(const std::shared_ptr<Shader>& shader, bool isInstanced) {
+	std::shared_ptr<Shader>& variant = rendererData.shaderVariants[isInstanced][shader.get()];
+	if (!variant) {
+		variant = ShaderLibrary::Instance().GetVariant(shader, isInstanced ? std::vector<std::string>{ "INSTANCED" } : std::vector<std::string>{});
+	}
+	return variant;
+}
+
+void Renderer::Submit(const std::shared_ptr<Shader> shader, const std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, GLenum primitiveType, uint32_t indexOffset, uint32_t indexCount) {
+	shader->Bind();
+	shader->UploadUniformMat4(TransformUniform, transform); // ModelMatrix
 
 	vertexArray->Bind();
 	RenderCommand::DrawIndexed(vertexArray, indexCount, primitiveType, indexOffset);
@@ -54,20 +235,418 @@ void Renderer::Submit(const std::shared_ptr<Shader> shader, const std::shared_pt
 // High-Level Command Library
 
 void Renderer::DrawMesh(MeshComponent& mesh, MeshRendererComponent& meshRenderer, std::shared_ptr<Shader> shader, TransformComponent& transform) {
-	shader->Bind();
-	shader->UploadUniformFloat4("u_Color", meshRenderer.Color);
-	Renderer::Submit(shader, mesh.vertexArray, transform.GetTransform());
+	Enqueue(shader, mesh.vertexArray, transform.GetTransform(), meshRenderer.Color, GL_TRIANGLES);
+	rendererData.drawQueue.back().mesh = &mesh;
+	rendererData.drawQueue.back().entityID = mesh.entityID;
+}
+
+void Renderer::DrawLines(const std::vector<glm::vec3>& vertices, const glm::mat4& transform, const glm::vec4& color, bool loop, int entityID) {
+	if (vertices.size() < 2) return;
+	rendererData.lineStrips.push_back({ &vertices, transform, color, loop, entityID });
+}
+
+void Renderer::Enqueue(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, const glm::vec4& color, GLenum primitiveType, DrawPass pass) {
+	// pass 2 bits | shader 10 bits | depth 24 bits, front-to-back | vertex array 16 bits | material 12 bits
+	// Depth comes before the vertex array, meshes rarely share one but near opaque meshes hide far ones from early-z.
+	float distance = glm::length(glm::vec3(transform[3]) - rendererData.cameraPosition);
+	uint32_t distanceBits;
+	std::memcpy(&distanceBits, &distance, sizeof(distanceBits)); // ordered like the float for non-negative values
+	uint32_t colorHash = (uint32_t)(color.r * 255.0f) * 73856093u ^ (uint32_t)(color.g * 255.0f) * 19349663u ^ (uint32_t)(color.b * 255.0f) * 83492791u ^ (uint32_t)(color.a * 255.0f);
+	uint64_t key = ((uint64_t)pass << 62)
+		| ((uint64_t)(shader->GetRendererID() & 0x3FF) << 52)
+		| ((uint64_t)(distanceBits >> 8) << 28)
+		| ((uint64_t)(vertexArray->GetRendererID() & 0xFFFF) << 12)
+		| (uint64_t)(colorHash & 0xFFF);
+	rendererData.drawQueue.push_back({ key, shader, vertexArray, transform, color, primitiveType });
+}
+
+void Renderer::SetMultiDrawEnabled(bool isEnabled) {
+	rendererData.isMultiDrawEnabled = isEnabled;
+}
+
+// Writes the indirect commands and instance data for the meshes among the sorted draws, grouped by geometry, into the rings.
+static void BuildMultiDraw(const std::vector<Renderer::DrawCommand>& queue, const std::vector<std::pair<uint64_t, uint32_t>>& order, size_t begin, size_t end) {
+	for (auto& [hash, members] : rendererData.instanceGroups) { members.clear(); }
+	rendererData.instanceGroupOrder.clear();
+	for (size_t i = begin; i < end; i++) {
+		const Renderer::DrawCommand& command = queue[order[i].second];
+		if (!command.mesh || command.mesh->Indices.empty()) continue;
+		std::vector<uint32_t>& members = rendererData.instanceGroups[command.mesh->geometryHash];
+		if (members.empty()) {
+			rendererData.instanceGroupOrder.push_back(command.mesh->geometryHash);
+		}
+		members.push_back(order[i].second);
+	}
+
+	// uploading a geometry can rebuild the arena and move the ranges of the others, so all are uploaded before any range is used
+	GeometryArena& arena = GeometryArena::Instance();
+	auto acquire = [&](const MeshComponent& mesh) -> const GeometryArena::Range& {
+		return arena.Acquire(mesh.geometryHash, &mesh.Vertices[0].Position, sizeof(MeshComponent::MeshVertex), mesh.Vertices.size(), mesh.Indices);
+	};
+	for (uint64_t hash : rendererData.instanceGroupOrder) {
+		acquire(*queue[rendererData.instanceGroups[hash][0]].mesh);
+	}
+
+	rendererData.indirectCount = (uint32_t)rendererData.instanceGroupOrder.size();
+	rendererData.multiDrawTriangles = 0;
+	rendererData.multiDrawInstances = 0;
+	if (rendererData.indirectCount == 0) return;
+	uint32_t instanceCount = 0;
+	for (uint64_t hash : rendererData.instanceGroupOrder) {
+		instanceCount += (uint32_t)rendererData.instanceGroups[hash].size();
+	}
+
+	// aligned to whole instances, so the base instance of the first one is the offset divided by the size
+	const uint32_t instanceSize = (uint32_t)sizeof(RendererData::InstanceData);
+	uint32_t instanceOffset;
+	auto* instances = static_cast<RendererData::InstanceData*>(rendererData.instanceRing->Allocate(instanceCount * instanceSize, instanceSize, instanceOffset));
+	auto* commands = static_cast<DrawElementsIndirectCommand*>(rendererData.indirectRing->Allocate(
+		rendererData.indirectCount * (uint32_t)sizeof(DrawElementsIndirectCommand), 4, rendererData.indirectOffset));
+	uint32_t baseInstance = instanceOffset / instanceSize;
+	for (uint64_t hash : rendererData.instanceGroupOrder) {
+		const std::vector<uint32_t>& members = rendererData.instanceGroups[hash];
+		const GeometryArena::Range& range = acquire(*queue[members[0]].mesh);
+		*commands++ = { range.indexCount, (uint32_t)members.size(), range.firstIndex, (int32_t)range.firstVertex, baseInstance };
+		for (uint32_t member : members) {
+			*instances++ = { queue[member].entityID, queue[member].color, queue[member].transform };
+		}
+		baseInstance += (uint32_t)members.size();
+		rendererData.multiDrawTriangles += range.indexCount / 3 * (uint32_t)members.size();
+	}
+	rendererData.multiDrawInstances = instanceCount;
+}
+
+// Vertex array of TransparentVertex rings, rebuilt when one of them has grown. generations stores the ring generations it was built for.
+static const std::shared_ptr<VertexArray>& GetStreamVertexArray(std::shared_ptr<VertexArray>& vertexArray, uint32_t& generations,
+	const RingBuffer<VertexBuffer>& vertexRing, const RingBuffer<IndexBuffer>& indexRing) {
+	const uint32_t ringGenerations = vertexRing.GetGeneration() ^ (indexRing.GetGeneration() << 16);
+	if (!vertexArray || generations != ringGenerations) {
+		const std::shared_ptr<VertexBuffer>& vertexBuffer = vertexRing.GetBuffer();
+		vertexBuffer->SetLayout({
+			{ ShaderDataType::Float3, "a_Position" },
+			{ ShaderDataType::Int, "a_EntityID" },
+			{ ShaderDataType::Float4, "a_Color" },
+		});
+		vertexArray = std::make_shared<VertexArray>();
+		vertexArray->AddVertexBuffer(vertexBuffer);
+		vertexArray->SetIndexBuffer(indexRing.GetBuffer());
+		generations = ringGenerations;
+	}
+	return vertexArray;
 }
 
-void Renderer::DrawMeshTriangle(const MeshComponent& mesh, const MeshRendererComponent& meshRenderer, const std::shared_ptr<Shader>& shader, const TransformComponent& transform, uint32_t triangleNo) {
+// Writes the world-space vertices of all lines straight into the line rings and draws them as one line strip
+static void DrawLineBatch() {
+	std::vector<RendererData::LineStrip>& strips = rendererData.lineStrips;
+	if (strips.empty()) return;
+
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	for (const RendererData::LineStrip& strip : strips) {
+		vertexCount += (uint32_t)strip.vertices->size();
+		indexCount += (uint32_t)strip.vertices->size() + (strip.isLooped ? 1 : 0) + 1; // back to the first vertex, restart index
+	}
+	const uint32_t vertexSize = (uint32_t)sizeof(Renderer::LineVertex);
+	uint32_t vertexOffset, indexOffset;
+	auto* vertices = static_cast<Renderer::LineVertex*>(rendererData.lineVertexRing->Allocate(vertexSize * vertexCount, vertexSize, vertexOffset));
+	auto* indices = static_cast<uint32_t*>(rendererData.lineIndexRing->Allocate((uint32_t)sizeof(uint32_t) * indexCount, sizeof(uint32_t), indexOffset));
+	uint32_t index = vertexOffset / vertexSize;
+	for (const RendererData::LineStrip& strip : strips) {
+		const uint32_t firstIndex = index;
+		for (const glm::vec3& vertex : *strip.vertices) {
+			*vertices++ = { glm::vec3(strip.transform * glm::vec4(vertex, 1.0f)), strip.entityID, strip.color };
+			*indices++ = index++;
+		}
+		if (strip.isLooped) {
+			*indices++ = firstIndex;
+		}
+		*indices++ = 0xFFFFFFFF; // GL_PRIMITIVE_RESTART_FIXED_INDEX
+	}
+	strips.clear();
+
+	// colors come from the vertices
+	const std::shared_ptr<Shader> shader = GetShaderVariant(rendererData.lineShader, false);
 	shader->Bind();
-	shader->UploadUniformFloat4("u_Color", meshRenderer.Color);
-	Renderer::Submit(shader, mesh.vertexArray, transform.GetTransform(), GL_TRIANGLES, triangleNo * 3, 3);
+	shader->UploadUniformFloat4(ColorUniform, glm::vec4(1.0f));
+	const std::shared_ptr<VertexArray>& vertexArray = GetStreamVertexArray(rendererData.lineVertexArray, rendererData.lineRingGenerations,
+		*rendererData.lineVertexRing, *rendererData.lineIndexRing);
+	Renderer::Submit(shader, vertexArray, glm::mat4(1.0f), GL_LINE_STRIP, indexOffset / sizeof(uint32_t), indexCount);
 }
 
-void Renderer::DrawLines(std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, const glm::vec4& color, bool loop) {
-	std::shared_ptr<Shader> shader = ShaderLibrary::Instance().Get("SolidColor");
+void Renderer::ExecuteDrawQueue() {
+	std::vector<DrawCommand>& queue = rendererData.drawQueue;
+	std::vector<std::pair<uint64_t, uint32_t>>& order = rendererData.drawOrder;
+	order.clear();
+	for (uint32_t i = 0; i < (uint32_t)queue.size(); i++) {
+		order.push_back({ queue[i].key, i });
+	}
+	std::sort(order.begin(), order.end());
+
+	Shader* boundShader = nullptr;
+	glm::vec4 boundColor;
+	auto bind = [&](const DrawCommand& command, const glm::vec4& color, bool isInstanced) -> Shader& {
+		Shader& shader = *GetShaderVariant(command.shader, isInstanced);
+		if (&shader != boundShader) {
+			shader.Bind();
+			boundShader = &shader;
+			boundColor = color;
+			shader.UploadUniformFloat4(ColorUniform, color);
+		}
+		else if (color != boundColor) {
+			boundColor = color;
+			shader.UploadUniformFloat4(ColorUniform, color);
+		}
+		return shader;
+	};
+
+	// commands of a shader are contiguous in sorted order, all meshes of a shader's run are drawn together at its first mesh
+	size_t runEnd = 0;
+	bool areRunMeshesDrawn = false;
+	for (size_t i = 0; i < order.size(); i++) {
+		const DrawCommand& command = queue[order[i].second];
+		if (i == runEnd) {
+			for (runEnd = i; runEnd < order.size() && queue[order[runEnd].second].shader == command.shader; runEnd++);
+			areRunMeshesDrawn = false;
+		}
+
+		if (rendererData.isMultiDrawEnabled && command.mesh) {
+			if (areRunMeshesDrawn) continue;
+			areRunMeshesDrawn = true;
+
+			BuildMultiDraw(queue, order, i, runEnd);
+			if (rendererData.indirectCount == 0) continue;
+			GeometryArena& arena = GeometryArena::Instance();
+			RingBuffer<VertexBuffer>& instanceRing = *rendererData.instanceRing;
+			if (!rendererData.arenaVertexArray || rendererData.arenaGeneration != arena.GetGeneration() || rendererData.instanceRingGeneration != instanceRing.GetGeneration()) {
+				// locations 1, 2 and 3-6 follow the arena's positions, see FlatShader.glsl
+				instanceRing.GetBuffer()->SetLayout({
+					{ ShaderDataType::Int, "a_EntityID" },
+					{ ShaderDataType::Float4, "a_Color" },
+					{ ShaderDataType::Mat4, "a_Transform" },
+				});
+				rendererData.arenaVertexArray = std::make_shared<VertexArray>();
+				rendererData.arenaVertexArray->AddVertexBuffer(arena.GetVertexBuffer());
+				rendererData.arenaVertexArray->AddVertexBuffer(instanceRing.GetBuffer(), true);
+				rendererData.arenaVertexArray->SetIndexBuffer(arena.GetIndexBuffer());
+				rendererData.arenaGeneration = arena.GetGeneration();
+				rendererData.instanceRingGeneration = instanceRing.GetGeneration();
+			}
+
+			// the color comes from the instance, u_Color only tints
+			bind(command, glm::vec4(1.0f), true);
+			rendererData.arenaVertexArray->Bind();
+			rendererData.indirectRing->GetBuffer()->Bind();
+			RenderCommand::MultiDrawIndexedIndirect(rendererData.indirectCount, rendererData.indirectOffset, rendererData.multiDrawTriangles);
+			RenderCommand::frameStats.multiDrawnMeshes += (int)rendererData.multiDrawInstances;
+			continue;
+		}
+
+		Shader& shader = bind(command, command.color, false);
+		shader.UploadUniformMat4(TransformUniform, command.transform);
+		command.vertexArray->Bind(); // skipped by RenderCommand when already bound
+		RenderCommand::DrawIndexed(command.vertexArray, 0, command.primitiveType);
+	}
+	queue.clear();
+
+	DrawLineBatch();
+}
+
+TransparencySorter& Renderer::GetTransparencySorter() {
+	return rendererData.transparencySorter;
+}
+
+const LightClusters& Renderer::GetLightClusters() {
+	return rendererData.lightClusters;
+}
+
+void Renderer::BeginTransparentBatch(TransparencyMode mode) {
+	rendererData.transparencyMode = mode;
+	rendererData.transparentVertices.clear();
+	rendererData.transparentMeshIndices.clear();
+	rendererData.transparentItemDistances.clear();
+	rendererData.transparentItemTriangles.clear();
+}
+
+static void SubmitTransparentBSPMesh(const MeshComponent& mesh, const MeshRendererComponent& meshRenderer, const WorldMeshCacheComponent& worldMesh) {
+	const BSPTree& tree = *mesh.bspTree;
+	uint32_t baseVertex = (uint32_t)rendererData.transparentVertices.size();
+	for (const glm::vec3& worldVertexPos : worldMesh.Positions) {
+		rendererData.transparentVertices.push_back({ worldVertexPos, mesh.entityID, meshRenderer.Color });
+	}
+
+	// traverse in object-space. Which side of a plane the camera is on does not change under an affine transform.
+	auto& order = rendererData.bspOrder;
+	order.clear();
+	if (rendererData.transparencyMode == Renderer::TransparencyMode::WeightedBlended) {
+		for (uint32_t t = 0; t < tree.GetTriangles().size(); t++)
+			order.push_back(t);
+	}
+	else {
+		glm::vec3 eye = glm::vec3(worldMesh.InverseTransform * glm::vec4{ rendererData.cameraPosition, 1.0f });
+		tree.Traverse(eye, order);
+	}
+
+	uint32_t firstTriangle = (uint32_t)rendererData.transparentMeshIndices.size() / 3;
+	for (uint32_t t : order) {
+		const glm::uvec3& triangle = tree.GetTriangles()[t];
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[0]);
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[1]);
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[2]);
+	}
+	// whole mesh is sorted among other items by the distance to its center
+	rendererData.transparentItemDistances.push_back(glm::length(worldMesh.Center - rendererData.cameraPosition));
+	rendererData.transparentItemTriangles.push_back({ firstTriangle, (uint32_t)order.size() });
+}
+
+void Renderer::SubmitTransparentMesh(const MeshComponent& mesh, const MeshRendererComponent& meshRenderer, const WorldMeshCacheComponent& worldMesh) {
+	if (mesh.bspTree) {
+		SubmitTransparentBSPMesh(mesh, meshRenderer, worldMesh);
+		return;
+	}
+
+	// world-space positions are cached, only copied here
+	uint32_t baseVertex = (uint32_t)rendererData.transparentVertices.size();
+	for (size_t i = 0; i < mesh.Vertices.size(); i++) {
+		rendererData.transparentVertices.push_back({ worldMesh.Positions[i], mesh.Vertices[i].EntityID, meshRenderer.Color });
+	}
+
+	uint32_t firstTriangle = (uint32_t)rendererData.transparentMeshIndices.size() / 3;
+	for (const glm::uvec3& triangle : mesh.Indices) {
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[0]);
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[1]);
+		rendererData.transparentMeshIndices.push_back(baseVertex + triangle[2]);
+	}
+
+	// order does not matter for OIT, no need for distances
+	if (rendererData.transparencyMode == TransparencyMode::WeightedBlended) return;
+
+	const uint32_t numTriangles = (uint32_t)worldMesh.CentroidX.size();
+	auto& distances = rendererData.transparentItemDistances;
+	size_t firstItem = distances.size();
+	distances.resize(firstItem + numTriangles);
+	Math::Distances(worldMesh.CentroidX.data(), worldMesh.CentroidY.data(), worldMesh.CentroidZ.data(), numTriangles, rendererData.cameraPosition, distances.data() + firstItem);
+	for (uint32_t i = 0; i < numTriangles; i++) {
+		rendererData.transparentItemTriangles.push_back({ firstTriangle + i, 1 });
+	}
+}
+
+// Copies the batch's vertices into the vertex ring and returns the index of the first one. The vertex array is rebuilt when a ring has grown.
+static uint32_t WriteTransparentVertices() {
+	const uint32_t vertexSize = (uint32_t)sizeof(Renderer::TransparentVertex);
+	uint32_t vertexOffset;
+	void* vertices = rendererData.transparentVertexRing->Allocate(vertexSize * (uint32_t)rendererData.transparentVertices.size(), vertexSize, vertexOffset);
+	std::memcpy(vertices, rendererData.transparentVertices.data(), vertexSize * rendererData.transparentVertices.size());
+	return vertexOffset / vertexSize;
+}
+
+static void DrawTransparentBatchWeightedBlended(bool isFlatShaded) {
+	// Everything is drawn into OIT targets of the size of the current render target, then composited onto it
+	const uint32_t targetFramebufferID = RenderCommand::GetBoundFramebuffer();
+	const glm::uvec4 viewport = RenderCommand::GetViewport();
+	uint32_t width = viewport[2];
+	uint32_t height = viewport[3];
+
+	auto& oitFramebuffer = rendererData.oitFramebuffer;
+	if (!oitFramebuffer) {
+		FramebufferSpecification spec;
+		spec.Attachments = { FramebufferTextureFormat::RGBA16F, FramebufferTextureFormat::R16F, FramebufferTextureFormat::RED_INTEGER, FramebufferTextureFormat::Depth };
+		spec.Width = width;
+		spec.Height = height;
+		oitFramebuffer = std::make_shared<Framebuffer>(spec);
+	}
+	else if (oitFramebuffer->GetSpecification().Width != width || oitFramebuffer->GetSpecification().Height != height) {
+		oitFramebuffer->Resize(width, height);
+	}
+
+	// transparent surfaces behind opaque ones should be occluded
+	glBlitNamedFramebuffer(targetFramebufferID, oitFramebuffer->GetRendererID(), 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	oitFramebuffer->Bind();
+	oitFramebuffer->ClearAttachment(0, 0.0f);
+	oitFramebuffer->ClearAttachment(1, 1.0f);
+	oitFramebuffer->ClearAttachment(2, -1);
+
+	const uint32_t baseVertex = WriteTransparentVertices();
+	const std::vector<uint32_t>& meshIndices = rendererData.transparentMeshIndices;
+	uint32_t indexOffset;
+	uint32_t* indices = static_cast<uint32_t*>(rendererData.transparentIndexRing->Allocate((uint32_t)(sizeof(uint32_t) * meshIndices.size()), sizeof(uint32_t), indexOffset));
+	for (size_t i = 0; i < meshIndices.size(); i++) {
+		indices[i] = baseVertex + meshIndices[i];
+	}
+	const std::shared_ptr<VertexArray>& vertexArray = GetStreamVertexArray(rendererData.transparentVertexArray, rendererData.transparentRingGenerations,
+		*rendererData.transparentVertexRing, *rendererData.transparentIndexRing);
+
+	RenderCommand::SetDepthMask(false);
+	RenderCommand::SetColorMask(2, false);
+	RenderCommand::SetBlendFunc(0, GL_ONE, GL_ONE);
+	RenderCommand::SetBlendFunc(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	const std::shared_ptr<Shader> accumulationShader = GetShaderVariant(ShaderLibrary::Instance().Get("WeightedBlendedOIT"), false);
+	accumulationShader->Bind();
+	accumulationShader->UploadUniformFloat4("u_Color", glm::vec4{ 1.0f, 1.0f, 1.0f, 1.0f });
+	accumulationShader->UploadUniformInt("u_IsFlatShaded", isFlatShaded);
+	Renderer::Submit(accumulationShader, vertexArray, glm::mat4(1.0f), GL_TRIANGLES, indexOffset / sizeof(uint32_t), (uint32_t)meshIndices.size());
+	RenderCommand::SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Entity IDs of the nearest transparent surfaces, so that picking matches what is in front. Only the ID target is
+	// written, testing and writing the copy of the opaque depth.
+	RenderCommand::SetColorMask(0, false);
+	RenderCommand::SetColorMask(1, false);
+	RenderCommand::SetColorMask(2, true);
+	RenderCommand::SetDepthMask(true);
+	accumulationShader->UploadUniformInt("u_IsFlatShaded", false);
+	Renderer::Submit(accumulationShader, vertexArray, glm::mat4(1.0f), GL_TRIANGLES, indexOffset / sizeof(uint32_t), (uint32_t)meshIndices.size());
+	RenderCommand::SetColorMask(0, true);
+	RenderCommand::SetColorMask(1, true);
+
+	// composite over the opaque image
+	RenderCommand::BindFramebuffer(targetFramebufferID);
+	RenderCommand::SetCapability(GL_DEPTH_TEST, false);
+	RenderCommand::BindTextureUnit(0, oitFramebuffer->GetColorAttachmentRendererID(0));
+	RenderCommand::BindTextureUnit(1, oitFramebuffer->GetColorAttachmentRendererID(1));
+	RenderCommand::BindTextureUnit(2, oitFramebuffer->GetColorAttachmentRendererID(2));
+	std::shared_ptr<Shader> compositeShader = ShaderLibrary::Instance().Get("OITComposite");
+	compositeShader->Bind();
+	compositeShader->UploadUniformInt("u_Accumulation", 0);
+	compositeShader->UploadUniformInt("u_Revealage", 1);
+	compositeShader->UploadUniformInt("u_EntityIDs", 2);
+	RenderCommand::DrawArrays(rendererData.emptyVertexArray, 3);
+	RenderCommand::SetCapability(GL_DEPTH_TEST, true);
+	RenderCommand::SetDepthMask(true);
+}
+
+void Renderer::EndTransparentBatch(const std::shared_ptr<Shader>& batchShader, bool isFlatShaded) {
+	// transparent triangles are tested against the depth of the opaque meshes
+	ExecuteDrawQueue();
+	if (rendererData.transparentMeshIndices.empty()) return;
+
+	if (rendererData.transparencyMode == TransparencyMode::WeightedBlended) {
+		DrawTransparentBatchWeightedBlended(isFlatShaded);
+		return;
+	}
+
+	// sort transparent triangles (and BSP meshes) by distance to camera, farthest first
+	const std::vector<uint32_t>& order = rendererData.transparencySorter.Sort(rendererData.transparentItemDistances, rendererData.cameraPosition);
+
+	// sorted indices are written straight into the index ring
+	const uint32_t baseVertex = WriteTransparentVertices();
+	const uint32_t indexCount = (uint32_t)rendererData.transparentMeshIndices.size();
+	uint32_t indexOffset;
+	uint32_t* destination = static_cast<uint32_t*>(rendererData.transparentIndexRing->Allocate((uint32_t)sizeof(uint32_t) * indexCount, sizeof(uint32_t), indexOffset));
+	for (uint32_t item : order) {
+		const glm::uvec2& triangles = rendererData.transparentItemTriangles[item];
+		const uint32_t* source = &rendererData.transparentMeshIndices[3 * triangles.x];
+		for (uint32_t i = 0; i < 3 * triangles.y; i++) {
+			*destination++ = baseVertex + source[i];
+		}
+	}
+	const std::shared_ptr<VertexArray>& vertexArray = GetStreamVertexArray(rendererData.transparentVertexArray, rendererData.transparentRingGenerations,
+		*rendererData.transparentVertexRing, *rendererData.transparentIndexRing);
+
+	// draw them without writing to depth buffer. Colors come from the vertices.
+	RenderCommand::SetDepthMask(false);
+	const std::shared_ptr<Shader> shader = GetShaderVariant(batchShader, false);
 	shader->Bind();
-	shader->UploadUniformFloat4("u_Color", color);
-	Renderer::Submit(shader, vertexArray, transform, loop ? GL_LINE_LOOP : GL_LINE_STRIP);
+	shader->UploadUniformFloat4("u_Color", glm::vec4{ 1.0f, 1.0f, 1.0f, 1.0f });
+	Renderer::Submit(shader, vertexArray, glm::mat4(1.0f), GL_TRIANGLES, indexOffset / sizeof(uint32_t), indexCount);
+	RenderCommand::SetDepthMask(true);
 }
\ No newline at end of file
@@ -2,25 +2,85 @@
 
 #include "RenderCommand.h"
 #include "Camera.h"
+#include "LightClusters.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "TransparencySorter.h"
 #include "../Scene/Components.h"
 
 class Renderer {
 public:
+	// Uniform block binding points shared by all shaders, see the Camera and Lights blocks
+	static const uint32_t CameraBinding = 0;
+	static const uint32_t LightsBinding = 1;
+	// Shader storage block binding points of the clustered lights, see LightClusters
+	static const uint32_t PointLightsBinding = 2;
+	static const uint32_t LightClustersBinding = 3;
+	static const uint32_t ClusterLightIndicesBinding = 4;
+
 	struct LightInfo {
 		glm::vec3 position;
 		float intensity;
+		float range; // 0 for unlimited
+	};
+
+	// Vertex of the transparent and line batches. Positions are already in world-space so that triangles or lines of different entities can share one draw call.
+	struct TransparentVertex {
+		glm::vec3 Position;
+		int EntityID;
+		glm::vec4 Color;
+	};
+	using LineVertex = TransparentVertex;
+
+	enum class DrawPass : uint8_t {
+		Opaque = 0,
+	};
+
+	// Deferred draw, sorted by key before execution so that draws sharing a shader, vertex array or color are adjacent
+	struct DrawCommand {
+		uint64_t key;
+		std::shared_ptr<Shader> shader;
+		std::shared_ptr<VertexArray> vertexArray;
+		glm::mat4 transform;
+		glm::vec4 color;
+		GLenum primitiveType;
+		MeshComponent* mesh = nullptr; // set for meshes, which are drawn from the GeometryArena
+		int32_t entityID = -1;
+	};
+
+	enum class TransparencyMode {
+		SortedTriangles = 0, // exact for non-intersecting triangles, needs a CPU sort every frame
+		WeightedBlended, // order-independent approximation, no sorting
 	};
 
 	static void Init();
 
 	static void BeginScene(const Camera& camera, const glm::mat4& cameraTransform, const std::vector<Renderer::LightInfo>& lightInfos);
 	static void EndScene();
+	static const glm::mat4& GetProjection();
+	static const glm::mat4& GetViewProjection();
+	static const glm::vec3& GetCameraPosition();
 
 	static void Submit(const std::shared_ptr<Shader> shader, const std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform = glm::mat4(1.0f), GLenum primitiveType = GL_TRIANGLES, uint32_t indexOffset = 0, uint32_t indexCount = 0);
 
 	static void DrawMesh(MeshComponent& mesh, MeshRendererComponent& meshRenderer, std::shared_ptr<Shader> shader, TransformComponent& transform);
-	static void DrawMeshTriangle(const MeshComponent& mesh, const MeshRendererComponent& meshRenderer, const std::shared_ptr<Shader>& shader, const TransformComponent& transform, uint32_t triangleNo);
-	static void DrawLines(std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, const glm::vec4& color, bool loop = false);
+	// Adds a polyline to the line batch, drawn with one draw call after the opaque draws. vertices have to stay alive until then.
+	static void DrawLines(const std::vector<glm::vec3>& vertices, const glm::mat4& transform, const glm::vec4& color, bool loop = false, int entityID = -1);
+	// Queues a draw with u_Color, executed at EndScene or before the transparent batch
+	static void Enqueue(const std::shared_ptr<Shader>& shader, const std::shared_ptr<VertexArray>& vertexArray, const glm::mat4& transform, const glm::vec4& color, GLenum primitiveType = GL_TRIANGLES, DrawPass pass = DrawPass::Opaque);
+	// Sorts the queued draws by key and executes them, binding shaders and vertex arrays only when they change.
+	// Meshes are drawn with one multi-draw per shader, as instances when they share geometry. The line batch is drawn after them.
+	static void ExecuteDrawQueue();
+	// When disabled, meshes are drawn one by one from their own vertex arrays
+	static void SetMultiDrawEnabled(bool isEnabled);
+
+	// Transparent triangles of all meshes are collected and drawn with a single draw call
+	// either sorted back-to-front or accumulated into Weighted Blended OIT targets and composited.
+	// Meshes with a BSP tree keep their traversal order and are sorted as a whole.
+	static void BeginTransparentBatch(TransparencyMode mode = TransparencyMode::SortedTriangles);
+	static void SubmitTransparentMesh(const MeshComponent& mesh, const MeshRendererComponent& meshRenderer, const WorldMeshCacheComponent& worldMesh);
+	// shader is used in SortedTriangles mode. WeightedBlended mode has its own shader, and only needs to know whether to flat shade.
+	static void EndTransparentBatch(const std::shared_ptr<Shader>& shader, bool isFlatShaded = true);
+	static TransparencySorter& GetTransparencySorter();
+	static const LightClusters& GetLightClusters();
 };
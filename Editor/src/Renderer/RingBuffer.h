@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include <glad/glad.h>
+
+#include "RenderCommand.h"
+
+// GPU buffer for data written every frame, such as instance data or transparent triangles. It has immutable storage
+// that stays mapped (persistent and coherent), so writes go straight into it without glBufferData reallocations.
+// The buffer is split into FrameCount parts used in turn. Each part is fenced at the end of its frame, and the CPU waits
+// only when the GPU is still reading it FrameCount frames later.
+// When a frame does not fit into its part, the buffer is replaced by one twice as large. Draws already issued keep the old one.
+// Buffer is VertexBuffer, IndexBuffer, DrawIndirectBuffer or ShaderStorageBuffer, whichever binding the data is used through.
+template<typename Buffer>
+class RingBuffer {
+public:
+	static const uint32_t FrameCount = 3;
+
+	explicit RingBuffer(uint32_t frameSize) { Create(frameSize); }
+	~RingBuffer() { Release(); }
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	// Moves to the next part, waiting for the GPU when it has not finished the frame that last used it
+	void BeginFrame() {
+		frame = (frame + 1) % FrameCount;
+		frameOffset = 0;
+		if (fences[frame]) {
+			if (glClientWaitSync(fences[frame], 0, 0) == GL_TIMEOUT_EXPIRED) {
+				RenderCommand::frameStats.ringStalls++;
+				glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+			}
+			glDeleteSync(fences[frame]);
+			fences[frame] = nullptr;
+		}
+		RenderCommand::frameStats.ringCapacity += frameSize;
+	}
+
+	// Fences the part after the frame's draws that read it
+	void EndFrame() {
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// Space for size bytes that can be written until the frame ends. byteOffset is from the start of the buffer
+	// and a multiple of alignment, which can be the size of a vertex so that byteOffset / alignment is its index.
+	void* Allocate(uint32_t size, uint32_t alignment, uint32_t& byteOffset) {
+		uint32_t begin = (frame * frameSize + frameOffset + alignment - 1) / alignment * alignment;
+		if (begin + size > (frame + 1) * frameSize) {
+			Release();
+			Create(std::max(2 * frameSize, size + alignment));
+			begin = (frame * frameSize + alignment - 1) / alignment * alignment;
+		}
+		frameOffset = begin + size - frame * frameSize;
+		byteOffset = begin;
+		RenderCommand::frameStats.ringBytes += size;
+		return mapped + begin;
+	}
+
+	const std::shared_ptr<Buffer>& GetBuffer() const { return buffer; }
+	// Changes whenever the buffer is replaced, vertex arrays that use it have to be rebuilt
+	uint32_t GetGeneration() const { return generation; }
+private:
+	void Create(uint32_t size) {
+		frameSize = size;
+		frameOffset = 0;
+		buffer = std::make_shared<Buffer>();
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glNamedBufferStorage(buffer->GetRendererID(), (GLsizeiptr)FrameCount * frameSize, nullptr, flags);
+		mapped = static_cast<uint8_t*>(glMapNamedBufferRange(buffer->GetRendererID(), 0, (GLsizeiptr)FrameCount * frameSize, flags));
+		generation++;
+	}
+
+	void Release() {
+		for (GLsync& fence : fences) {
+			if (fence) glDeleteSync(fence);
+			fence = nullptr;
+		}
+		if (buffer) glUnmapNamedBuffer(buffer->GetRendererID());
+		buffer = nullptr;
+		mapped = nullptr;
+	}
+private:
+	std::shared_ptr<Buffer> buffer;
+	uint8_t* mapped = nullptr;
+	uint32_t frameSize = 0;
+	uint32_t frameOffset = 0; // bytes used in the current part
+	uint32_t frame = 0;
+	GLsync fences[FrameCount] = {};
+	uint32_t generation = 0;
+};
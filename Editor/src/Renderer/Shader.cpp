@@ -1,12 +1,35 @@
+#include <algorithm>
 #include <array>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 
 #include "glad/glad.h"
 #include "glm/gtc/type_ptr.hpp"
 
 #include "Shader.h"
+#include "RenderCommand.h"
+
+// Interned uniform names, the index of a name is its position
+static std::vector<std::string>& GetUniformNames() {
+	static std::vector<std::string> names;
+	return names;
+}
+
+UniformID::UniformID(const char* name) {
+	static std::unordered_map<std::string, uint32_t> indices;
+	auto [it, isInserted] = indices.try_emplace(name, (uint32_t)GetUniformNames().size());
+	if (isInserted) {
+		GetUniformNames().push_back(name);
+	}
+	index = it->second;
+}
+
+const std::string& UniformID::GetName() const {
+	return GetUniformNames()[index];
+}
 
 static GLenum ShaderTypeFromString(const std::string& type) {
 	if (type == "vertex")
@@ -20,13 +43,19 @@ static GLenum ShaderTypeFromString(const std::string& type) {
 	return 0;
 }
 
-Shader::Shader(const std::string& filepath) {
-	std::string source = ReadFile(filepath);
-	auto shaderSources = PreProcess(source);
-	Compile(shaderSources);
+Shader::Shader(const std::string& filepath)
+	: Shader(filepath, {}) {
+}
 
+Shader::Shader(const std::string& filepath, const std::vector<std::string>& defines, bool isAsync)
+	: filepath(filepath), defines(defines) {
 	std::filesystem::path path = filepath;
 	name = path.stem().string();
+
+	Compile(PreProcess(ReadSource()));
+	if (!isAsync) {
+		UpdateCompile(true);
+	}
 }
 
 Shader::Shader(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource) 
@@ -35,10 +64,44 @@ Shader::Shader(const std::string& name, const std::string& vertexSource, const s
 	sources[GL_VERTEX_SHADER] = vertexSource;
 	sources[GL_FRAGMENT_SHADER] = fragmentSource;
 	Compile(sources);
+	UpdateCompile(true);
 }
 
 Shader::~Shader() {
-	glDeleteProgram(rendererID);
+	if (compileJob) {
+		ShaderCompiler::Instance().Release(compileJob);
+	}
+	SetProgram(0);
+}
+
+void Shader::Reload() {
+	assert(!filepath.empty()); // Shaders made from source strings have no file to reload
+	Compile(PreProcess(ReadSource()));
+}
+
+bool Shader::UpdateCompile(bool wait) {
+	if (!compileJob) return true;
+	if (!wait && !ShaderCompiler::Instance().IsFinished(compileJob)) return false;
+
+	GLuint program = ShaderCompiler::Instance().Finish(compileJob);
+	if (program) {
+		ShaderLibrary::Instance().SaveProgramBinary(compileJob->sources, program);
+		SetProgram(program);
+	}
+	hasFailedCompile = !program;
+	compileJob = nullptr;
+	return true;
+}
+
+void Shader::SetProgram(uint32_t program) {
+	if (rendererID) {
+		RenderCommand::OnProgramDeleted(rendererID);
+		glDeleteProgram(rendererID);
+	}
+	rendererID = program;
+	if (rendererID) {
+		Reflect();
+	}
 }
 
 std::string Shader::ReadFile(const std::string& filepath) {
@@ -57,6 +120,50 @@ std::string Shader::ReadFile(const std::string& filepath) {
 	return result;
 }
 
+std::string Shader::ReadSource() {
+	includes.clear();
+	std::vector<std::string> includeStack = { std::filesystem::path(filepath).lexically_normal().generic_string() };
+	return ResolveIncludes(ReadFile(filepath), std::filesystem::path(filepath).parent_path(), includeStack);
+}
+
+std::string Shader::ResolveIncludes(const std::string& source, const std::filesystem::path& directory, std::vector<std::string>& includeStack) {
+	std::string result = source;
+	const char* includeToken = "#include";
+	size_t pos = result.find(includeToken, 0);
+	while (pos != std::string::npos) {
+		if (pos > 0 && result[pos - 1] != '\n') {
+			pos = result.find(includeToken, pos + 1); // not at the start of a line, e.g. in a comment
+			continue;
+		}
+		size_t eol = std::min(result.find_first_of("\r\n", pos), result.size());
+		size_t nameBegin = result.find('"', pos);
+		size_t nameEnd = nameBegin < eol ? result.find('"', nameBegin + 1) : std::string::npos;
+		assert(nameEnd < eol); // Syntax Error, expects #include "file"
+
+		std::filesystem::path includePath = (directory / result.substr(nameBegin + 1, nameEnd - nameBegin - 1)).lexically_normal();
+		std::string includeFilepath = includePath.generic_string();
+		if (std::find(includeStack.begin(), includeStack.end(), includeFilepath) != includeStack.end()) {
+			std::cerr << "Include cycle in shader " << name << ":";
+			for (const std::string& file : includeStack) {
+				std::cerr << " " << file << " ->";
+			}
+			std::cerr << " " << includeFilepath << std::endl;
+			result.erase(pos, eol - pos);
+			pos = result.find(includeToken, pos);
+			continue;
+		}
+		if (std::find(includes.begin(), includes.end(), includeFilepath) == includes.end()) {
+			includes.push_back(includeFilepath);
+		}
+		includeStack.push_back(includeFilepath);
+		std::string included = ResolveIncludes(ReadFile(includeFilepath), includePath.parent_path(), includeStack);
+		includeStack.pop_back();
+		result.replace(pos, eol - pos, included);
+		pos = result.find(includeToken, pos + included.size());
+	}
+	return result;
+}
+
 std::unordered_map<GLenum, std::string> Shader::PreProcess(const std::string& source) {
 	std::unordered_map<GLenum, std::string> shaderSources;
 
@@ -72,150 +179,199 @@ std::unordered_map<GLenum, std::string> Shader::PreProcess(const std::string& so
 
 		size_t nextLinePos = source.find_first_not_of("\r\n", eol);
 		pos = source.find(typeToken, nextLinePos);
-		shaderSources[ShaderTypeFromString(type)] = (pos == std::string::npos) ? 
+		std::string& stageSource = shaderSources[ShaderTypeFromString(type)];
+		stageSource = (pos == std::string::npos) ? 
 			source.substr(nextLinePos) : 
 			source.substr(nextLinePos, pos - nextLinePos);
+
+		// #version has to stay the first statement
+		if (!defines.empty()) {
+			size_t versionPos = stageSource.find("#version");
+			size_t insertPos = versionPos == std::string::npos ? 0 : stageSource.find('\n', versionPos) + 1;
+			std::string defineLines;
+			for (const std::string& define : defines) {
+				defineLines += "#define " + define + "\n";
+			}
+			stageSource.insert(insertPos, defineLines);
+		}
 	}
 
 	return shaderSources;
 }
 
-void Shader::Compile(std::unordered_map<GLenum, std::string>& shaderSources) {
-	GLuint program = glCreateProgram();
+void Shader::Compile(std::unordered_map<GLenum, std::string> shaderSources) {
 	assert(shaderSources.size() <= 3); // We only support a geometry, a vertex and a fragment shader for now.
-	std::array<GLenum, 3> glShaderIDs;
-	int glShaderIdIndex = 0;
-	for (auto& kv : shaderSources) {
-		GLenum type = kv.first;
-		const std::string& source = kv.second;
-
-		// Taken from https://www.khronos.org/opengl/wiki/Shader_Compilation#Example and modified
-		GLuint shader = glCreateShader(type);
-
-		const GLchar* sourceCStr = (const GLchar*)source.c_str();
-		glShaderSource(shader, 1, &sourceCStr, 0);
-
-		glCompileShader(shader);
-
-		GLint isCompiled = 0;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
-
-		if (isCompiled == GL_FALSE)
-		{
-			GLint maxLength = 0;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
-
-			std::vector<GLchar> infoLog(maxLength);
-			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
-
-			glDeleteShader(shader);
-
-			std::cerr << "Shader compilation failure." << std::endl
-				<< infoLog.data() << std::endl;
+	if (compileJob) {
+		ShaderCompiler::Instance().Release(compileJob);
+		compileJob = nullptr;
+	}
+	if (GLuint cachedProgram = ShaderLibrary::Instance().LoadProgramBinary(shaderSources)) {
+		SetProgram(cachedProgram);
+		return;
+	}
+	compileJob = ShaderCompiler::Instance().Submit(name, std::move(shaderSources));
+}
 
-			return;
+void Shader::Reflect() {
+	uniforms.clear();
+	uniformBlocks.clear();
+	locationsByID.clear();
+	missingUniforms.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv(rendererID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+	std::vector<GLchar> nameBuffer;
+	for (GLint i = 0; i < uniformCount; i++) {
+		const GLenum properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+		GLint values[5];
+		glGetProgramResourceiv(rendererID, GL_UNIFORM, i, 5, properties, 5, nullptr, values);
+		// members of uniform blocks have no location, they are set through the block's buffer
+		if (values[4] != -1) continue;
+
+		nameBuffer.resize(values[0]);
+		glGetProgramResourceName(rendererID, GL_UNIFORM, i, values[0], nullptr, nameBuffer.data());
+		std::string uniformName = nameBuffer.data();
+		if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+			uniformName.resize(uniformName.size() - 3);
 		}
-
-		glAttachShader(program, shader);
-		glShaderIDs[glShaderIdIndex++] = shader;
+		uniforms[uniformName] = { values[2], (GLenum)values[1], values[3] };
 	}
 
-	glLinkProgram(program);
-
-	GLint isLinked = 0;
-	glGetProgramiv(program, GL_LINK_STATUS, (int*)&isLinked);
-	if (isLinked == GL_FALSE)
-	{
-		GLint maxLength = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
-
-		std::vector<GLchar> infoLog(maxLength);
-		glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
-
-		glDeleteProgram(program);
-		for (auto id : glShaderIDs) 
-			glDeleteShader(id);
+	GLint blockCount = 0;
+	glGetProgramInterfaceiv(rendererID, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCount);
+	for (GLint i = 0; i < blockCount; i++) {
+		const GLenum properties[] = { GL_NAME_LENGTH, GL_BUFFER_DATA_SIZE, GL_BUFFER_BINDING };
+		GLint values[3];
+		glGetProgramResourceiv(rendererID, GL_UNIFORM_BLOCK, i, 3, properties, 3, nullptr, values);
+		nameBuffer.resize(values[0]);
+		glGetProgramResourceName(rendererID, GL_UNIFORM_BLOCK, i, values[0], nullptr, nameBuffer.data());
+		uniformBlocks[nameBuffer.data()] = { (uint32_t)i, values[1], values[2] };
+	}
+}
 
-		std::cerr << "Shader link failure." << std::endl
-			<< infoLog.data() << std::endl;
+int32_t Shader::GetUniformLocation(const std::string& name) {
+	auto it = uniforms.find(name);
+	if (it != uniforms.end()) return it->second.location;
 
-		return;
+	if (missingUniforms.insert(name).second) {
+		std::cerr << "Shader " << this->name << " has no active uniform " << name << std::endl;
 	}
+	return -1;
+}
 
-	for (auto id : glShaderIDs) {
-		glDetachShader(program, id);
-		glDeleteShader(id);
+int32_t Shader::GetUniformLocation(UniformID id) {
+	if (id.GetIndex() >= locationsByID.size()) {
+		locationsByID.resize(id.GetIndex() + 1, -2);
 	}
-
-	rendererID = program;
+	int32_t& location = locationsByID[id.GetIndex()];
+	if (location == -2) {
+		location = GetUniformLocation(id.GetName());
+	}
+	return location;
 }
 
 void Shader::Bind() const {
-	glUseProgram(rendererID);
+	RenderCommand::UseProgram(rendererID);
 }
 
 void Shader::Unbind() const {
-	glUseProgram(0);
+	RenderCommand::UseProgram(0);
 }
 
 void Shader::UploadUniformInt(const std::string& name, int value) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform1i(location, value);
+	glUniform1i(GetUniformLocation(name), value);
+}
+
+void Shader::UploadUniformInt(UniformID id, int value) {
+	glUniform1i(GetUniformLocation(id), value);
 }
 
 void Shader::UploadUniformFloat(const std::string& name, float value) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform1f(location, value);
+	glUniform1f(GetUniformLocation(name), value);
+}
+
+void Shader::UploadUniformFloat(UniformID id, float value) {
+	glUniform1f(GetUniformLocation(id), value);
 }
 
 void Shader::UploadUniformFloat2(const std::string& name, const glm::vec2& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform2f(location, values.x, values.y);
+	glUniform2f(GetUniformLocation(name), values.x, values.y);
+}
+
+void Shader::UploadUniformFloat2(UniformID id, const glm::vec2& values) {
+	glUniform2f(GetUniformLocation(id), values.x, values.y);
 }
 
 void Shader::UploadUniformFloat3(const std::string& name, const glm::vec3& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform3f(location, values.x, values.y, values.z);
+	glUniform3f(GetUniformLocation(name), values.x, values.y, values.z);
+}
+
+void Shader::UploadUniformFloat3(UniformID id, const glm::vec3& values) {
+	glUniform3f(GetUniformLocation(id), values.x, values.y, values.z);
 }
 
 void Shader::UploadUniformFloat4(const std::string& name, const glm::vec4& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform4f(location, values.x, values.y, values.z, values.w);
+	glUniform4f(GetUniformLocation(name), values.x, values.y, values.z, values.w);
+}
+
+void Shader::UploadUniformFloat4(UniformID id, const glm::vec4& values) {
+	glUniform4f(GetUniformLocation(id), values.x, values.y, values.z, values.w);
 }
 
 void Shader::UploadUniformMat2(const std::string& name, const glm::mat2& matrix) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix2fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::UploadUniformMat2(UniformID id, const glm::mat2& matrix) {
+	glUniformMatrix2fv(GetUniformLocation(id), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::UploadUniformMat3(const std::string& name, const glm::mat3& matrix) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix3fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::UploadUniformMat3(UniformID id, const glm::mat3& matrix) {
+	glUniformMatrix3fv(GetUniformLocation(id), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::UploadUniformMat4(const std::string& name, const glm::mat4& matrix) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::UploadUniformMat4(UniformID id, const glm::mat4& matrix) {
+	glUniformMatrix4fv(GetUniformLocation(id), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::UploadUniformFloats(const std::string& name, const std::vector<float>& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform1fv(location, values.size(), values.data());
+	glUniform1fv(GetUniformLocation(name), values.size(), values.data());
+}
+
+void Shader::UploadUniformFloats(UniformID id, const std::vector<float>& values) {
+	glUniform1fv(GetUniformLocation(id), values.size(), values.data());
 }
 
 void Shader::UploadUniformFloat2s(const std::string& name, const std::vector<glm::vec2>& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform2fv(location, values.size() * 2, glm::value_ptr(values.data()[0]));
+	glUniform2fv(GetUniformLocation(name), values.size(), glm::value_ptr(values.data()[0]));
+}
+
+void Shader::UploadUniformFloat2s(UniformID id, const std::vector<glm::vec2>& values) {
+	glUniform2fv(GetUniformLocation(id), values.size(), glm::value_ptr(values.data()[0]));
 }
 
 void Shader::UploadUniformFloat3s(const std::string& name, const std::vector<glm::vec3>& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform3fv(location, values.size() * 3, glm::value_ptr(values.data()[0]));
+	glUniform3fv(GetUniformLocation(name), values.size(), glm::value_ptr(values.data()[0]));
+}
+
+void Shader::UploadUniformFloat3s(UniformID id, const std::vector<glm::vec3>& values) {
+	glUniform3fv(GetUniformLocation(id), values.size(), glm::value_ptr(values.data()[0]));
 }
 
 void Shader::UploadUniformFloat4s(const std::string& name, const std::vector<glm::vec4>& values) {
-	GLint location = glGetUniformLocation(rendererID, name.c_str());
-	glUniform4fv(location, values.size() * 4, glm::value_ptr(values.data()[0]));
+	glUniform4fv(GetUniformLocation(name), values.size(), glm::value_ptr(values.data()[0]));
+}
+
+void Shader::UploadUniformFloat4s(UniformID id, const std::vector<glm::vec4>& values) {
+	glUniform4fv(GetUniformLocation(id), values.size(), glm::value_ptr(values.data()[0]));
 }
 
 // Shader Library
@@ -230,17 +386,29 @@ void ShaderLibrary::Add(const std::shared_ptr<Shader>& shader) {
 }
 
 std::shared_ptr<Shader> ShaderLibrary::Load(const std::string& filepath) {
-	auto shader = std::make_shared<Shader>(filepath);
+	auto shader = LoadAsync(filepath);
 	Add(shader);
 	return shader;
 }
 
 std::shared_ptr<Shader> ShaderLibrary::Load(const std::string& name, const std::string& filepath) {
-	auto shader = std::make_shared<Shader>(filepath);
+	auto shader = LoadAsync(filepath);
 	Add(name, shader);
 	return shader;
 }
 
+std::shared_ptr<Shader> ShaderLibrary::LoadAsync(const std::string& filepath, const std::vector<std::string>& defines) {
+	auto shader = std::make_shared<Shader>(filepath, defines, true);
+	if (shader->IsCompiling()) {
+		compilingShaders.push_back(shader);
+	}
+	WatchFile(filepath);
+	for (const std::string& include : shader->GetIncludes()) {
+		WatchFile(include);
+	}
+	return shader;
+}
+
 std::shared_ptr<Shader> ShaderLibrary::Get(const std::string& name) {
 	assert(Exists(name)); // Shader not found!
 	return shaders[name];
@@ -250,3 +418,162 @@ bool ShaderLibrary::Exists(const std::string& name) const {
 	return shaders.find(name) != shaders.end();
 }
 
+std::shared_ptr<Shader> ShaderLibrary::GetVariant(const std::shared_ptr<Shader>& shader, const std::vector<std::string>& defines) {
+	if (defines.empty()) return shader;
+	assert(!shader->GetFilepath().empty()); // Variants are compiled from the shader's file
+
+	std::string key = shader->GetFilepath();
+	for (const std::string& define : defines) {
+		key += "|" + define;
+	}
+	std::shared_ptr<Shader>& variant = variants[key];
+	if (!variant) {
+		variant = LoadAsync(shader->GetFilepath(), defines);
+	}
+	return variant;
+}
+
+void ShaderLibrary::Update() {
+	compilingShaders.erase(std::remove_if(compilingShaders.begin(), compilingShaders.end(),
+		[this](const std::shared_ptr<Shader>& shader) {
+			if (!shader->UpdateCompile(false)) return false;
+			failedCompiles += shader->HasFailedCompile();
+			return true;
+		}), compilingShaders.end());
+
+	// files are checked a few times a second rather than every frame
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastFileCheck < std::chrono::milliseconds(500)) return;
+	lastFileCheck = now;
+
+	std::vector<std::string> newIncludes;
+	for (auto& [filepath, writeTime] : fileWriteTimes) {
+		std::error_code error;
+		auto newWriteTime = std::filesystem::last_write_time(filepath, error);
+		if (error || newWriteTime == writeTime) continue;
+
+		// the loaded shader and its variants, or the shaders including the file
+		std::vector<std::shared_ptr<Shader>> fileShaders;
+		for (auto* shaderMap : { &shaders, &variants }) {
+			for (auto& [key, shader] : *shaderMap) {
+				const std::vector<std::string>& includes = shader->GetIncludes();
+				if (shader->GetFilepath() == filepath || std::find(includes.begin(), includes.end(), filepath) != includes.end()) {
+					fileShaders.push_back(shader);
+				}
+			}
+		}
+		// a file saved again while its last version compiles is reloaded after that
+		if (std::any_of(fileShaders.begin(), fileShaders.end(), [](const std::shared_ptr<Shader>& shader) { return shader->IsCompiling(); })) continue;
+
+		writeTime = newWriteTime;
+		reloads++;
+		lastReloadedFile = filepath;
+		for (auto& shader : fileShaders) {
+			shader->Reload();
+			if (shader->IsCompiling()) {
+				compilingShaders.push_back(shader);
+			}
+			newIncludes.insert(newIncludes.end(), shader->GetIncludes().begin(), shader->GetIncludes().end());
+		}
+	}
+	// files included since the last reload, added after iterating fileWriteTimes
+	for (const std::string& include : newIncludes) {
+		WatchFile(include);
+	}
+}
+
+void ShaderLibrary::WatchFile(const std::string& filepath) {
+	std::error_code error;
+	fileWriteTimes.try_emplace(filepath, std::filesystem::last_write_time(filepath, error));
+}
+
+void ShaderLibrary::WaitForCompiles() {
+	for (auto& shader : compilingShaders) {
+		shader->UpdateCompile(true);
+		failedCompiles += shader->HasFailedCompile();
+	}
+	compilingShaders.clear();
+}
+
+void ShaderLibrary::SetBinaryCacheDirectory(const std::string& directory) {
+	binaryCacheDirectory = directory;
+	if (directory.empty()) return;
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0) {
+		std::cerr << "The driver has no program binary formats, shaders are always compiled" << std::endl;
+		binaryCacheDirectory.clear();
+		return;
+	}
+	driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+}
+
+// File of the cached binary, named after an FNV-1a hash of the driver and the stage sources
+static std::string GetProgramBinaryPath(const std::string& directory, const std::string& driver, const std::unordered_map<GLenum, std::string>& shaderSources) {
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	add(driver.data(), driver.size());
+	// in a fixed stage order, the map's order may differ between runs
+	for (GLenum type : { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER }) {
+		auto it = shaderSources.find(type);
+		if (it == shaderSources.end()) continue;
+		add(&type, sizeof(type));
+		add(it->second.data(), it->second.size());
+	}
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	return (std::filesystem::path(directory) / name).string();
+}
+
+uint32_t ShaderLibrary::LoadProgramBinary(const std::unordered_map<GLenum, std::string>& shaderSources) {
+	if (binaryCacheDirectory.empty()) return 0;
+
+	// the file is the binary format followed by the binary
+	std::ifstream in(GetProgramBinaryPath(binaryCacheDirectory, driver, shaderSources), std::ios::in | std::ios::binary);
+	GLenum format = 0;
+	if (!in || !in.read(reinterpret_cast<char*>(&format), sizeof(format))) {
+		binaryCacheMisses++;
+		return 0;
+	}
+	std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+	GLint isLinked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+	if (isLinked == GL_FALSE) {
+		// e.g. after a driver update that kept the version string, the binary is replaced once compiled
+		glDeleteProgram(program);
+		binaryCacheMisses++;
+		return 0;
+	}
+	binaryCacheHits++;
+	return program;
+}
+
+void ShaderLibrary::SaveProgramBinary(const std::unordered_map<GLenum, std::string>& shaderSources, uint32_t program) {
+	if (binaryCacheDirectory.empty()) return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length == 0) return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	std::ofstream out(GetProgramBinaryPath(binaryCacheDirectory, driver, shaderSources), std::ios::out | std::ios::binary);
+	if (!out) {
+		std::cerr << "Could not write the program binary to " << binaryCacheDirectory << std::endl;
+		return;
+	}
+	out.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	out.write(binary.data(), binary.size());
+}
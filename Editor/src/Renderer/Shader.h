@@ -1,22 +1,71 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <glm/glm.hpp>
 
+#include "ShaderCompiler.h"
+
 // TODO: Remove
 typedef unsigned int GLenum;
 
+// Uniform name interned into a process-wide index, typically held in a static so that uploads
+// index a per-shader location table instead of looking the name up. Same name, same index.
+class UniformID {
+public:
+	explicit UniformID(const char* name);
+	uint32_t GetIndex() const { return index; }
+	const std::string& GetName() const;
+private:
+	uint32_t index;
+};
+
 class Shader {
 public:
+	// Active uniform reflected after linking. Arrays are named without the [0] suffix.
+	struct UniformInfo {
+		int32_t location;
+		GLenum type;
+		int32_t size; // array length, 1 for non-arrays
+	};
+	struct UniformBlockInfo {
+		uint32_t index;
+		int32_t dataSize; // bytes
+		int32_t binding;
+	};
+
 	Shader(const std::string& name, const std::string& vertexSrc, const std::string& fragmentSrc);
 	Shader(const std::string& filepath);
+	// Variant of a shader file, each of defines is inserted as a #define after #version, e.g. "INSTANCED".
+	// With isAsync it is compiled in the background and has no program until UpdateCompile swaps it in.
+	Shader(const std::string& filepath, const std::vector<std::string>& defines, bool isAsync = false);
 	~Shader();
 
 	void Bind() const;
 	void Unbind() const;
 
+	// Compiles the file again in the background, the current program stays in use until the new one links
+	void Reload();
+	// Swaps in the program compiled in the background once it is finished, or waits for it with wait.
+	// False while it is still compiling. A program that fails to compile or link leaves the current one in place.
+	bool UpdateCompile(bool wait);
+	bool IsCompiling() const { return compileJob != nullptr; }
+	// True when the last compile failed, the shader keeps its previous program if it had one
+	bool HasFailedCompile() const { return hasFailedCompile; }
+
 	const std::string& GetName() const { return name; }
+	const std::string& GetFilepath() const { return filepath; }
+	const std::vector<std::string>& GetDefines() const { return defines; }
+	// Files pulled in by #include, directly or through other included files
+	const std::vector<std::string>& GetIncludes() const { return includes; }
+	uint32_t GetRendererID() const { return rendererID; }
+	const std::unordered_map<std::string, UniformInfo>& GetUniforms() const { return uniforms; }
+	const std::unordered_map<std::string, UniformBlockInfo>& GetUniformBlocks() const { return uniformBlocks; }
+	bool HasUniform(const std::string& name) const { return uniforms.find(name) != uniforms.end(); }
 
 	void UploadUniformInt(const std::string& name, int value);
 	void UploadUniformFloat(const std::string& name, float value);
@@ -32,29 +81,101 @@ public:
 	void UploadUniformFloat2s(const std::string& name, const std::vector<glm::vec2>& values);
 	void UploadUniformFloat3s(const std::string& name, const std::vector<glm::vec3>& values);
 	void UploadUniformFloat4s(const std::string& name, const std::vector<glm::vec4>& values);
+
+	void UploadUniformInt(UniformID id, int value);
+	void UploadUniformFloat(UniformID id, float value);
+	void UploadUniformFloat2(UniformID id, const glm::vec2& values);
+	void UploadUniformFloat3(UniformID id, const glm::vec3& values);
+	void UploadUniformFloat4(UniformID id, const glm::vec4& values);
+
+	void UploadUniformMat2(UniformID id, const glm::mat2& matrix);
+	void UploadUniformMat3(UniformID id, const glm::mat3& matrix);
+	void UploadUniformMat4(UniformID id, const glm::mat4& matrix);
+
+	void UploadUniformFloats(UniformID id, const std::vector<float>& values);
+	void UploadUniformFloat2s(UniformID id, const std::vector<glm::vec2>& values);
+	void UploadUniformFloat3s(UniformID id, const std::vector<glm::vec3>& values);
+	void UploadUniformFloat4s(UniformID id, const std::vector<glm::vec4>& values);
 private:
 	std::string ReadFile(const std::string& filepath);
+	// Reads filepath with its includes resolved, and records the included files
+	std::string ReadSource();
+	// Replaces #include "file" lines with the file's contents. Files are relative to directory, the including file's.
+	// includeStack holds the files being resolved, an #include of one of them is a cycle and is dropped with an error.
+	std::string ResolveIncludes(const std::string& source, const std::filesystem::path& directory, std::vector<std::string>& includeStack);
 	std::unordered_map<GLenum, std::string> PreProcess(const std::string& source);
-	void Compile(std::unordered_map<GLenum, std::string>& shaderSources);
+	void Compile(std::unordered_map<GLenum, std::string> shaderSources);
+	void SetProgram(uint32_t program);
+	void Reflect();
+	// -1 for uniforms that are not active, reported once per shader and name
+	int32_t GetUniformLocation(const std::string& name);
+	int32_t GetUniformLocation(UniformID id);
 private:
-	uint32_t rendererID;
+	uint32_t rendererID = 0; // 0 until the first program has linked
+	std::shared_ptr<ShaderCompiler::Job> compileJob;
+	bool hasFailedCompile = false;
 	std::string name;
+	std::string filepath; // empty for shaders made from source strings
+	std::vector<std::string> defines;
+	std::vector<std::string> includes;
+	std::unordered_map<std::string, UniformInfo> uniforms;
+	std::unordered_map<std::string, UniformBlockInfo> uniformBlocks;
+	std::vector<int32_t> locationsByID; // indexed by UniformID, resolved on first use
+	std::unordered_set<std::string> missingUniforms; // already reported
 };
 
 class ShaderLibrary {
 public: 
 	void Add(const std::string& name, const std::shared_ptr<Shader>& shader);
 	void Add(const std::shared_ptr<Shader>& shader);
+	// Compiled in the background, the shader has no program until Update or WaitForCompiles swaps it in
 	std::shared_ptr<Shader> Load(const std::string& filepath);
 	std::shared_ptr<Shader> Load(const std::string& name, const std::string& filepath);
 
 	std::shared_ptr<Shader> Get(const std::string& name);
 	bool Exists(const std::string& name) const;
+	// Variant of a shader loaded from a file, compiled with defines in the background on first use and cached.
+	// The shader itself when defines is empty. The variant has no program while compiling or when it failed to.
+	std::shared_ptr<Shader> GetVariant(const std::shared_ptr<Shader>& shader, const std::vector<std::string>& defines);
+
+	// Swaps in the programs that finished compiling and reloads the shader files that changed. Called every frame, never waits.
+	void Update();
+	// Waits for the background compiles, e.g. those of Load at startup
+	void WaitForCompiles();
+	uint32_t GetVariantCount() const { return (uint32_t)variants.size(); }
+	// Shader files reloaded since startup because they or their includes changed, and the compiles that failed
+	uint32_t GetReloadCount() const { return reloads; }
+	uint32_t GetFailedCompileCount() const { return failedCompiles; }
+	const std::string& GetLastReloadedFile() const { return lastReloadedFile; }
+
+	// Programs are saved to directory with glGetProgramBinary, keyed by a hash of their sources (defines included)
+	// and the driver, and loaded back on later runs instead of compiling. Empty, the default, disables the cache.
+	void SetBinaryCacheDirectory(const std::string& directory);
+	// Program linked from the cached binary of these sources, 0 when there is none or the driver rejects it
+	uint32_t LoadProgramBinary(const std::unordered_map<GLenum, std::string>& shaderSources);
+	void SaveProgramBinary(const std::unordered_map<GLenum, std::string>& shaderSources, uint32_t program);
+	uint32_t GetBinaryCacheHitCount() const { return binaryCacheHits; }
+	uint32_t GetBinaryCacheMissCount() const { return binaryCacheMisses; }
 
 	static ShaderLibrary& Instance() { static ShaderLibrary instance; return instance; }
 	ShaderLibrary(ShaderLibrary const&) = delete;
 	ShaderLibrary& operator=(ShaderLibrary const&) = delete;
 private:
 	ShaderLibrary() = default;
+	// Shader of the file that is compiled in the background, and reloaded when the file changes
+	std::shared_ptr<Shader> LoadAsync(const std::string& filepath, const std::vector<std::string>& defines = {});
+	// Starts checking the file for changes
+	void WatchFile(const std::string& filepath);
 	std::unordered_map<std::string, std::shared_ptr<Shader>> shaders;
+	std::unordered_map<std::string, std::shared_ptr<Shader>> variants; // by file path and defines
+	std::vector<std::shared_ptr<Shader>> compilingShaders;
+	std::unordered_map<std::string, std::filesystem::file_time_type> fileWriteTimes; // of the loaded files and their includes
+	std::chrono::steady_clock::time_point lastFileCheck;
+	std::string binaryCacheDirectory;
+	std::string driver; // vendor, renderer and version, binaries of other drivers are not loaded
+	uint32_t binaryCacheHits = 0;
+	uint32_t binaryCacheMisses = 0;
+	uint32_t reloads = 0;
+	uint32_t failedCompiles = 0;
+	std::string lastReloadedFile;
 };
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "ShaderCompiler.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+
+// GL_KHR_parallel_shader_compile, glad is generated without extensions
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Issues the compiles and the link without asking for their status, which is what waits for them
+static void StartCompile(ShaderCompiler::Job& job) {
+	job.program = glCreateProgram();
+	for (auto& [type, source] : job.sources) {
+		GLuint shader = glCreateShader(type);
+		const GLchar* sourceCStr = (const GLchar*)source.c_str();
+		glShaderSource(shader, 1, &sourceCStr, 0);
+		glCompileShader(shader);
+		glAttachShader(job.program, shader);
+		job.shaders.push_back(shader);
+	}
+	glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(job.program);
+}
+
+static void DeleteShaders(ShaderCompiler::Job& job) {
+	for (GLuint shader : job.shaders) {
+		glDetachShader(job.program, shader);
+		glDeleteShader(shader);
+	}
+	job.shaders.clear();
+}
+
+// Linked program of a started job, 0 with the errors reported if it failed
+static GLuint CheckCompile(ShaderCompiler::Job& job) {
+	// Taken from https://www.khronos.org/opengl/wiki/Shader_Compilation#Example and modified
+	bool isCompiled = true;
+	for (GLuint shader : job.shaders) {
+		GLint status = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if (status == GL_FALSE) {
+			GLint maxLength = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+			std::vector<GLchar> infoLog(maxLength + 1);
+			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+			std::cerr << "Shader compilation failure in " << job.name << "." << std::endl
+				<< infoLog.data() << std::endl;
+			isCompiled = false;
+		}
+	}
+
+	GLint isLinked = 0;
+	glGetProgramiv(job.program, GL_LINK_STATUS, &isLinked);
+	if (isCompiled && isLinked == GL_FALSE) {
+		GLint maxLength = 0;
+		glGetProgramiv(job.program, GL_INFO_LOG_LENGTH, &maxLength);
+		std::vector<GLchar> infoLog(maxLength + 1);
+		glGetProgramInfoLog(job.program, maxLength, &maxLength, &infoLog[0]);
+		std::cerr << "Shader link failure in " << job.name << "." << std::endl
+			<< infoLog.data() << std::endl;
+	}
+
+	DeleteShaders(job);
+	if (!isCompiled || isLinked == GL_FALSE) {
+		glDeleteProgram(job.program);
+		job.program = 0;
+	}
+	return job.program;
+}
+
+void ShaderCompiler::Init() {
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++) {
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_KHR_parallel_shader_compile") == 0) {
+			isParallel = true;
+		}
+	}
+	if (isParallel) {
+		auto maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (maxShaderCompilerThreads) {
+			maxShaderCompilerThreads(0xFFFFFFFF); // as many as the driver wants
+		}
+	}
+}
+
+void ShaderCompiler::StartWorker(std::function<void(bool isCurrent)> setContextCurrent) {
+	assert(!worker.joinable()); // Worker already started
+	isStopping = false;
+	worker = std::thread(&ShaderCompiler::WorkerLoop, this, std::move(setContextCurrent));
+}
+
+void ShaderCompiler::Shutdown() {
+	if (!worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	condition.notify_all();
+	worker.join();
+	jobs.clear();
+}
+
+std::shared_ptr<ShaderCompiler::Job> ShaderCompiler::Submit(const std::string& name, std::unordered_map<uint32_t, std::string> sources) {
+	auto job = std::make_shared<Job>();
+	job->name = name;
+	job->sources = std::move(sources);
+	if (worker.joinable()) {
+		job->isOnWorker = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(job);
+		}
+		condition.notify_all();
+	}
+	else {
+		StartCompile(*job);
+	}
+	return job;
+}
+
+bool ShaderCompiler::IsFinished(const std::shared_ptr<Job>& job) {
+	if (job->isOnWorker) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return job->isFinished;
+	}
+	if (isParallel) {
+		GLint isCompleted = GL_FALSE;
+		glGetProgramiv(job->program, GL_COMPLETION_STATUS_KHR, &isCompleted);
+		return isCompleted == GL_TRUE;
+	}
+	return true;
+}
+
+uint32_t ShaderCompiler::Finish(const std::shared_ptr<Job>& job) {
+	if (job->isOnWorker) {
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&job]() { return job->isFinished; });
+		return job->program;
+	}
+	return CheckCompile(*job);
+}
+
+void ShaderCompiler::Release(const std::shared_ptr<Job>& job) {
+	if (job->isOnWorker) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!job->isFinished) {
+			// the worker deletes the program once done with it
+			job->isReleased = true;
+			return;
+		}
+	}
+	DeleteShaders(*job);
+	glDeleteProgram(job->program);
+	job->program = 0;
+}
+
+void ShaderCompiler::WorkerLoop(std::function<void(bool isCurrent)> setContextCurrent) {
+	setContextCurrent(true);
+	while (true) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return isStopping || !jobs.empty(); });
+			if (isStopping) break;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		StartCompile(*job);
+		CheckCompile(*job);
+		// the program is complete before the main context uses it
+		glFinish();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job->isFinished = true;
+			if (job->isReleased) {
+				glDeleteProgram(job->program);
+				job->program = 0;
+			}
+		}
+		condition.notify_all();
+	}
+	setContextCurrent(false);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Compiles and links programs without blocking the main thread. With GL_KHR_parallel_shader_compile the driver
+// compiles on its own threads and the main thread polls for completion. Without it, a worker thread with a context
+// shared with the main one does the compiling, and until that worker is started programs are compiled right away.
+class ShaderCompiler {
+public:
+	struct Job {
+		std::string name; // for error messages
+		std::unordered_map<uint32_t, std::string> sources; // by GL shader type
+		uint32_t program = 0;
+		std::vector<uint32_t> shaders; // attached to program until it is finished
+		bool isOnWorker = false;
+		// guarded by the compiler's mutex when on the worker
+		bool isFinished = false;
+		bool isReleased = false; // by the main thread before the worker finished it
+	};
+
+	static ShaderCompiler& Instance() { static ShaderCompiler instance; return instance; }
+	ShaderCompiler(ShaderCompiler const&) = delete;
+	ShaderCompiler& operator=(ShaderCompiler const&) = delete;
+
+	// Checks for the extension, called once GL is loaded
+	void Init();
+	bool IsParallel() const { return isParallel; }
+	// Moves compiles to a worker thread. It calls setContextCurrent(true) to make a context shared with the main one
+	// current before compiling, and setContextCurrent(false) when it stops.
+	void StartWorker(std::function<void(bool isCurrent)> setContextCurrent);
+	void Shutdown();
+
+	std::shared_ptr<Job> Submit(const std::string& name, std::unordered_map<uint32_t, std::string> sources);
+	// Whether Finish would return without waiting
+	bool IsFinished(const std::shared_ptr<Job>& job);
+	// Waits for the job, reports compile and link errors and returns the linked program, 0 if it failed
+	uint32_t Finish(const std::shared_ptr<Job>& job);
+	// Deletes the job's objects without waiting for it
+	void Release(const std::shared_ptr<Job>& job);
+private:
+	ShaderCompiler() = default;
+	~ShaderCompiler() { Shutdown(); }
+	void WorkerLoop(std::function<void(bool isCurrent)> setContextCurrent);
+private:
+	bool isParallel = false;
+	std::thread worker;
+	std::deque<std::shared_ptr<Job>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition; // signalled for new jobs and finished ones
+	bool isStopping = false;
+};
@@ -5,6 +5,8 @@
 #include <glad/glad.h>
 #include <stb/stb_image.h>
 
+#include "RenderCommand.h"
+
 Texture2D::Texture2D(const std::string& path) 
 	: path(path) {
 	int w, h, channels;
@@ -40,9 +42,10 @@ Texture2D::Texture2D(const std::string& path)
 }
 
 Texture2D::~Texture2D() {
+	RenderCommand::OnTexturesDeleted(&rendererID, 1);
 	glDeleteTextures(1, &rendererID);
 }
 
 void Texture2D::Bind(uint32_t slot) const {
-	glBindTextureUnit(slot, rendererID);
+	RenderCommand::BindTextureUnit(slot, rendererID);
 }
\ No newline at end of file
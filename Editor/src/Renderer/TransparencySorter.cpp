@@ -0,0 +1,138 @@
+#include "TransparencySorter.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+#include "../ThreadPool.h"
+
+// Inputs smaller than this are sorted on the calling thread only
+static const uint32_t minItemsPerChunk = 16384;
+
+uint32_t TransparencySorter::DistanceToKey(float distance) {
+	uint32_t bits;
+	std::memcpy(&bits, &distance, sizeof(float));
+	// flip the sign bit for positive floats, all bits for negative floats, so that unsigned order matches float order
+	uint32_t mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+	uint32_t ascending = bits ^ mask;
+	return ~ascending; // farthest first
+}
+
+void TransparencySorter::RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+	const uint32_t count = (uint32_t)items.size();
+	scratch.resize(count);
+	if (count < 2) return;
+
+	const uint32_t numChunks = std::max(1u, std::min(ThreadPool::Instance().GetThreadCount(), count / minItemsPerChunk));
+	const uint32_t chunkSize = (count + numChunks - 1) / numChunks;
+	std::vector<std::array<uint32_t, 256>> histograms(numChunks);
+
+	SortItem* src = items.data();
+	SortItem* dst = scratch.data();
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		auto countDigits = [&](uint32_t chunk) {
+			auto& histogram = histograms[chunk];
+			histogram.fill(0);
+			uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (uint32_t i = chunk * chunkSize; i < end; i++) {
+				histogram[(src[i].key >> shift) & 0xFF]++;
+			}
+		};
+		ThreadPool::Instance().ParallelFor(numChunks, countDigits);
+
+		// Turn histograms into write offsets. Digit major, chunk minor keeps the sort stable.
+		bool isPassNeeded = true;
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < 256; digit++) {
+			uint32_t digitCount = 0;
+			for (uint32_t chunk = 0; chunk < numChunks; chunk++) {
+				uint32_t c = histograms[chunk][digit];
+				histograms[chunk][digit] = offset;
+				offset += c;
+				digitCount += c;
+			}
+			// all keys share this digit, the pass would not change the order
+			if (digitCount == count) {
+				isPassNeeded = false;
+				break;
+			}
+		}
+		if (!isPassNeeded) continue;
+
+		auto scatter = [&](uint32_t chunk) {
+			auto& offsets = histograms[chunk];
+			uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (uint32_t i = chunk * chunkSize; i < end; i++) {
+				dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+			}
+		};
+		ThreadPool::Instance().ParallelFor(numChunks, scatter);
+		std::swap(src, dst);
+	}
+
+	if (src != items.data()) {
+		std::memcpy(items.data(), src, sizeof(SortItem) * count);
+	}
+}
+
+bool TransparencySorter::AdaptiveSort(std::vector<SortItem>& items, uint64_t maxMoves) {
+	uint64_t numMoves = 0;
+	for (size_t i = 1; i < items.size(); i++) {
+		SortItem item = items[i];
+		size_t j = i;
+		while (j > 0 && items[j - 1].key > item.key) {
+			items[j] = items[j - 1];
+			j--;
+		}
+		items[j] = item;
+		numMoves += i - j;
+		if (numMoves > maxMoves)
+			return false;
+	}
+	return true;
+}
+
+const std::vector<uint32_t>& TransparencySorter::Sort(const std::vector<float>& distances, const glm::vec3& cameraPosition) {
+	auto start = std::chrono::high_resolution_clock::now();
+	const uint32_t count = (uint32_t)distances.size();
+
+	bool isCoherent = method == Method::CoherentRadixSort
+		&& items.size() == count
+		&& glm::length(cameraPosition - lastCameraPosition) < coherenceDistance;
+	if (isCoherent) {
+		// start from last frame's order with updated keys. When the camera barely moved it is nearly sorted already.
+		for (SortItem& item : items) {
+			item.key = DistanceToKey(distances[item.index]);
+		}
+		lastMethodUsed = Method::CoherentRadixSort;
+		if (!AdaptiveSort(items, 4 * (uint64_t)count)) {
+			RadixSort(items, scratch);
+			lastMethodUsed = Method::RadixSort;
+		}
+	}
+	else {
+		items.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			items[i] = { DistanceToKey(distances[i]), i };
+		}
+		if (method == Method::StdSort) {
+			std::stable_sort(items.begin(), items.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+			lastMethodUsed = Method::StdSort;
+		}
+		else {
+			RadixSort(items, scratch);
+			lastMethodUsed = Method::RadixSort;
+		}
+	}
+	lastCameraPosition = cameraPosition;
+
+	order.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		order[i] = items[i].index;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastSortMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+	return order;
+}
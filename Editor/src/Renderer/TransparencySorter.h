@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Orders transparent triangles back-to-front using compact 32-bit depth keys.
+class TransparencySorter {
+public:
+	enum class Method { StdSort = 0, RadixSort, CoherentRadixSort };
+
+	struct SortItem {
+		uint32_t key; // larger key is drawn later, i.e. is closer to camera
+		uint32_t index;
+	};
+
+	// Returns indices of items (triangles or whole meshes) in the order they should be drawn (farthest first)
+	const std::vector<uint32_t>& Sort(const std::vector<float>& distances, const glm::vec3& cameraPosition);
+
+	// Maps distance to a key whose unsigned integer order is the reverse of distance order
+	static uint32_t DistanceToKey(float distance);
+	// Stable LSD radix sort on keys, 8-bits per pass. Passes are split among ThreadPool threads for large inputs.
+	static void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+	// Insertion sort, which is linear on almost sorted input. Returns false, leaving items partially sorted, when it needs more than maxMoves moves.
+	static bool AdaptiveSort(std::vector<SortItem>& items, uint64_t maxMoves);
+
+	float GetLastSortMilliseconds() const { return lastSortMilliseconds; }
+	Method GetLastMethodUsed() const { return lastMethodUsed; }
+public:
+	Method method = Method::CoherentRadixSort;
+	// Camera moves below this distance between frames are considered small enough to start from last frame's order
+	float coherenceDistance = 0.1f;
+private:
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::vector<uint32_t> order;
+	glm::vec3 lastCameraPosition = { 0.0f, 0.0f, 0.0f };
+	float lastSortMilliseconds = 0.0f;
+	Method lastMethodUsed = Method::StdSort;
+};
@@ -1,4 +1,5 @@
 #include "VertexArray.h"
+#include "RenderCommand.h"
 
 #include "glad/glad.h"
 
@@ -27,19 +28,20 @@ VertexArray::VertexArray() {
 }
 
 VertexArray::~VertexArray() {
+    RenderCommand::OnVertexArrayDeleted(rendererID);
     glDeleteVertexArrays(1, &rendererID);
 }
 
 void VertexArray::Bind() const {
-	glBindVertexArray(rendererID);
+	RenderCommand::BindVertexArray(rendererID);
 }
 
 void VertexArray::Unbind() const {
-	glBindVertexArray(0);
+	RenderCommand::BindVertexArray(0);
 }
 
-void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuffer) {
-	glBindVertexArray(rendererID);
+void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuffer, bool isPerInstance) {
+	RenderCommand::BindVertexArray(rendererID);
 	vertexBuffer->Bind();
 
     assert(vertexBuffer->GetLayout().GetElements().size()); // Vertex Buffer has no Layout!
@@ -60,6 +62,7 @@ void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuf
                 layout.GetStride(),
                 (const void*)element.Offset
             );
+            glVertexAttribDivisor(vertexBufferIndex, isPerInstance ? 1 : 0);
             vertexBufferIndex++;
         }
         break;
@@ -76,24 +79,26 @@ void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuf
                 layout.GetStride(),
                 (const void*)element.Offset
             );
+            glVertexAttribDivisor(vertexBufferIndex, isPerInstance ? 1 : 0);
             vertexBufferIndex++;
         }
         break;
         case ShaderDataType::Mat2:
         case ShaderDataType::Mat3:
         case ShaderDataType::Mat4: {
-            uint8_t count = element.GetComponentCount();
-            for (uint8_t i = 0; i < count; i++) {
+            // one attribute per column
+            uint8_t columnCount = element.Type == ShaderDataType::Mat2 ? 2 : element.Type == ShaderDataType::Mat3 ? 3 : 4;
+            for (uint8_t i = 0; i < columnCount; i++) {
                 glEnableVertexAttribArray(vertexBufferIndex);
                 glVertexAttribPointer(
                     vertexBufferIndex,
-                    count,
+                    columnCount,
                     ShaderDataTypeToOpenGLBaseType(element.Type),
                     element.Normalized ? GL_TRUE : GL_FALSE,
                     layout.GetStride(),
-                    (const void*)(element.Offset + sizeof(float) * count * i)
+                    (const void*)(element.Offset + sizeof(float) * columnCount * i)
                 );
-                glVertexAttribDivisor(vertexBufferIndex, 1);
+                glVertexAttribDivisor(vertexBufferIndex, isPerInstance ? 1 : 0);
                 vertexBufferIndex++;
             }
         }
@@ -107,7 +112,7 @@ void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuf
 }
 
 void VertexArray::SetIndexBuffer(const std::shared_ptr<IndexBuffer>& indexBuffer) {
-    glBindVertexArray(rendererID);
+    RenderCommand::BindVertexArray(rendererID);
     indexBuffer->Bind();
 
     this->indexBuffer = indexBuffer;
@@ -13,11 +13,15 @@ public:
 	void Bind() const;
 	void Unbind() const;
 
-	void AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuffer);
+	// Attributes of a per-instance buffer advance once per instance instead of once per vertex
+	void AddVertexBuffer(const std::shared_ptr<VertexBuffer>& vertexBuffer, bool isPerInstance = false);
 	void SetIndexBuffer(const std::shared_ptr<IndexBuffer>& indexBuffer);
 
 	const std::vector<std::shared_ptr<VertexBuffer>>& GetVertexBuffers() { return vertexBuffers; }
 	const std::shared_ptr<IndexBuffer>& GetIndexBuffer() { return indexBuffer; }
+	uint32_t GetRendererID() const { return rendererID; }
+	// Attributes are at locations 0 to count - 1
+	uint32_t GetAttributeCount() const { return vertexBufferIndex; }
 private:
 	uint32_t rendererID;
 	std::vector<std::shared_ptr<VertexBuffer>> vertexBuffers;
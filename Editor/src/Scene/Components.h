@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #define _USE_MATH_DEFINES
@@ -11,9 +12,11 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 #include <tinyobjloader/tiny_obj_loader.h>
+#include <entt/entt.hpp>
 
 #include "SceneCamera.h"
 #include "../Renderer/VertexArray.h"
+#include "../Renderer/BSPTree.h"
 
 class Component {
 public:
@@ -35,6 +38,8 @@ struct TagComponent : public Component {
 struct TransformComponent : public Component {
 	static const inline char* GetName() { return "TransformComponent"; }
 
+	// Relative to the parent. After changing these, patch the component in the registry.
+	// Scene refreshes cached matrices of patched transforms and their descendants once per frame.
 	glm::vec3 Translation = { 0.0f, 0.0f, 0.0f };
 	glm::vec3 Rotation = { 0.0f, 0.0f, 0.0f };
 	glm::vec3 Scale = { 1.0f, 1.0f, 1.0f };
@@ -42,14 +47,46 @@ struct TransformComponent : public Component {
 	TransformComponent() = default;
 	TransformComponent(const TransformComponent&) = default;
 	TransformComponent(const glm::vec3& translation) :
-		Translation(translation) {}
-	
-	glm::mat4 GetTransform() const {
+		Translation(translation) { UpdateCache(); }
+
+	// World transform, cached as of the last UpdateCache
+	const glm::mat4& GetTransform() const { return transform; }
+	const glm::mat4& GetInverseTransform() const { return inverseTransform; }
+	// Incremented on every UpdateCache, for caches derived from the transform
+	uint32_t GetVersion() const { return version; }
+
+	glm::mat4 ComputeLocalTransform() const {
 		glm::mat4 rotation = glm::toMat4(glm::quat(Rotation));
 		return glm::translate(glm::mat4(1.0f), Translation)
 			* rotation
 			* glm::scale(glm::mat4(1.0f), Scale);
 	}
+
+	void UpdateCache(const glm::mat4& parentTransform = glm::mat4(1.0f)) {
+		UpdateCache(parentTransform, ComputeLocalTransform());
+	}
+
+	// with a local transform computed elsewhere, such as by Math::ComposeTransforms
+	void UpdateCache(const glm::mat4& parentTransform, const glm::mat4& localTransform) {
+		transform = parentTransform * localTransform;
+		inverseTransform = glm::inverse(transform);
+		version++;
+	}
+private:
+	glm::mat4 transform{ 1.0f };
+	glm::mat4 inverseTransform{ 1.0f };
+	uint32_t version = 1;
+};
+
+// Only use Scene::SetParent to change, which keeps both sides of the relation in sync
+struct RelationshipComponent : public Component {
+	static const inline char* GetName() { return "RelationshipComponent"; }
+
+	entt::entity Parent = entt::null;
+	std::vector<entt::entity> Children;
+
+	RelationshipComponent() = default;
+	RelationshipComponent(const RelationshipComponent&) = default;
 };
 
 struct CameraComponent : public Component {
@@ -63,35 +100,17 @@ struct CameraComponent : public Component {
 	CameraComponent(const CameraComponent&) = default;
 };
 
+// Polyline in object-space. Lines have no GPU buffers of their own, the Renderer batches the vertices of all lines every frame.
 class LineComponent : public Component {
 public:
 	static const inline char* GetName() { return "LineComponent"; }
 
-	LineComponent() { ComputeVertexArray(); }
+	LineComponent() = default;
 	LineComponent(const LineComponent&) = default;
 	LineComponent(const std::vector<glm::vec3>& vertices) 
-		: Vertices(vertices) { ComputeVertexArray(); }
-
-	void ComputeVertexArray() {
-		vertexArray.reset(new VertexArray());
-		float* flat_array = static_cast<float*>(glm::value_ptr(Vertices.front()));
-		const auto vertexBuffer = std::make_shared<VertexBuffer>(flat_array, (uint32_t)(sizeof(float)*3*Vertices.size()));
-		vertexBuffer->SetLayout({
-			{ ShaderDataType::Float3, "a_Position" },
-			//{ ShaderDataType::Int, "a_EntityID" },
-		});
-		vertexArray->AddVertexBuffer(vertexBuffer);
-		std::vector<uint32_t> indices(Vertices.size());
-		for (uint32_t ix = 0; ix < indices.size(); ix++) {
-			indices[ix] = ix;
-		}
-		const auto squareIB = std::make_shared<IndexBuffer>(indices.data(), (uint32_t)(indices.size()));
-		vertexArray->SetIndexBuffer(squareIB);
-	}
-	std::shared_ptr<VertexArray>& GetVertexArray() { return vertexArray; }
+		: Vertices(vertices) {}
 public:
 	std::vector<glm::vec3> Vertices = { {0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f} };
-	std::shared_ptr<VertexArray> vertexArray = nullptr;
 };
 
 class MeshComponent : public Component{
@@ -117,15 +136,66 @@ public:
 		vertexArray = std::make_shared<VertexArray>();
 		vertexArray->AddVertexBuffer(vertexBuffer);
 		vertexArray->SetIndexBuffer(squareIB);
+
+		ComputeBounds();
+		ComputeGeometryHash();
 	}
 	MeshComponent(const MeshComponent&) = default;
 
 	void ComputeVertexArray() {
+		version = NewVersion();
 		for (auto& v : Vertices) { v.EntityID = entityID; }
 		vertexArray->GetVertexBuffers()[0]->Update(Vertices.data(), (uint32_t)(sizeof(MeshVertex) * Vertices.size()));
 
 		uint32_t* flat_index_array = static_cast<uint32_t*>(glm::value_ptr(Indices.front()));
 		vertexArray->GetIndexBuffer()->Update(flat_index_array, (uint32_t)(3 * Indices.size()));
+
+		ComputeBounds();
+		ComputeGeometryHash();
+		ComputeBSPTree();
+	}
+
+	// FNV-1a over positions and indices. Meshes with equal hashes are drawn as instances of one shared mesh.
+	void ComputeGeometryHash() {
+		uint64_t hash = 14695981039346656037ull;
+		auto add = [&hash](const void* data, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		};
+		for (const auto& v : Vertices) { add(&v.Position, sizeof(v.Position)); }
+		add(Indices.data(), Indices.size() * sizeof(glm::uvec3));
+		geometryHash = hash;
+	}
+
+	// Object-space bounding box and bounding sphere around the box center, used for culling
+	void ComputeBounds() {
+		BoundsMin = BoundsMax = Vertices.empty() ? glm::vec3(0.0f) : Vertices[0].Position;
+		for (const auto& v : Vertices) {
+			BoundsMin = glm::min(BoundsMin, v.Position);
+			BoundsMax = glm::max(BoundsMax, v.Position);
+		}
+		BoundingSphereCenter = 0.5f * (BoundsMin + BoundsMax);
+		float radiusSquared = 0.0f;
+		for (const auto& v : Vertices) {
+			glm::vec3 d = v.Position - BoundingSphereCenter;
+			radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+		}
+		BoundingSphereRadius = std::sqrt(radiusSquared);
+	}
+
+	// Builds the tree that orders transparent triangles of the mesh when UseBSP is set, releases it otherwise
+	void ComputeBSPTree() {
+		version = NewVersion();
+		if (!UseBSP) {
+			bspTree = nullptr;
+			return;
+		}
+		std::vector<glm::vec3> positions;
+		positions.reserve(Vertices.size());
+		for (const auto& v : Vertices) { positions.push_back(v.Position); }
+		bspTree = std::make_shared<BSPTree>(positions, Indices);
 	}
 public:
 	int entityID = -3; // -3 when component was not given an entityID
@@ -136,6 +206,21 @@ public:
 	};
 	std::vector<glm::uvec3> Indices = { {0, 1, 2} };
 	std::shared_ptr<VertexArray> vertexArray = nullptr;
+	// For static transparent meshes. Drawn in BSP traversal order instead of sorting their triangles every frame.
+	bool UseBSP = false;
+	std::shared_ptr<BSPTree> bspTree = nullptr;
+	glm::vec3 BoundsMin = { 0.0f, 0.0f, 0.0f };
+	glm::vec3 BoundsMax = { 0.0f, 0.0f, 0.0f };
+	glm::vec3 BoundingSphereCenter = { 0.0f, 0.0f, 0.0f };
+	float BoundingSphereRadius = 0.0f;
+	uint64_t geometryHash = 0;
+	// Changes whenever vertices, indices or the BSP tree are recomputed. Unique among all meshes.
+	uint32_t version = NewVersion();
+private:
+	static uint32_t NewVersion() {
+		static uint32_t lastVersion = 0;
+		return ++lastVersion;
+	}
 };
 
 class MeshObjLoaderComponent : public Component {
@@ -268,6 +353,16 @@ struct LineRendererComponent : public Component {
 		Color(color) {}
 };
 
+// Coarser versions of a loaded mesh, made from the cached LOD chain of its file. Maintained by the Scene.
+struct MeshLODComponent : public Component {
+	static const inline char* GetName() { return "MeshLODComponent"; }
+
+	std::vector<MeshComponent> Levels; // Levels[i] is LOD i + 1, LOD 0 is the loaded mesh itself
+	int CurrentLOD = 0;
+	int ForcedLOD = -1; // pins the LOD when not negative
+	uint32_t sourceVersion = 0; // version of the loaded mesh the levels were made for
+};
+
 struct MeshRendererComponent : public Component {
 	static const inline char* GetName() { return "MeshRendererComponent"; }
 
@@ -280,6 +375,70 @@ struct MeshRendererComponent : public Component {
 		Color(color), IsTransparent(isTransparent) {}
 };
 
+// World-space vertex positions and triangle centroids of a transparent mesh, used to build the transparent batch.
+// Recomputed only when the mesh or the transform they were computed with changes.
+struct WorldMeshCacheComponent : public Component {
+	static const inline char* GetName() { return "WorldMeshCacheComponent"; }
+
+	std::vector<glm::vec3> Positions; // positions of the BSP tree for meshes that have one
+	std::vector<float> CentroidX, CentroidY, CentroidZ; // one per triangle, empty for meshes with a BSP tree
+	glm::vec3 Center = { 0.0f, 0.0f, 0.0f }; // of the world-space bounding box
+	glm::mat4 InverseTransform{ 1.0f };
+
+	// Returns whether the cache was stale and recomputed
+	bool Update(const MeshComponent& mesh, const TransformComponent& transform) {
+		if (mesh.version == meshVersion && transform.GetVersion() == transformVersion)
+			return false;
+		meshVersion = mesh.version;
+		transformVersion = transform.GetVersion();
+
+		const glm::mat4& worldTransform = transform.GetTransform();
+		InverseTransform = transform.GetInverseTransform();
+		Positions.clear();
+		CentroidX.clear();
+		CentroidY.clear();
+		CentroidZ.clear();
+		if (mesh.bspTree) {
+			for (const glm::vec3& p : mesh.bspTree->GetPositions()) {
+				Positions.push_back(glm::vec3(worldTransform * glm::vec4{ p, 1.0f }));
+			}
+		}
+		else {
+			for (const MeshComponent::MeshVertex& v : mesh.Vertices) {
+				Positions.push_back(glm::vec3(worldTransform * glm::vec4{ v.Position, 1.0f }));
+			}
+			for (const glm::uvec3& triangle : mesh.Indices) {
+				glm::vec3 centroid = (Positions[triangle[0]] + Positions[triangle[1]] + Positions[triangle[2]]) / 3.0f;
+				CentroidX.push_back(centroid.x);
+				CentroidY.push_back(centroid.y);
+				CentroidZ.push_back(centroid.z);
+			}
+		}
+
+		glm::vec3 min = Positions.empty() ? glm::vec3(0.0f) : Positions[0];
+		glm::vec3 max = min;
+		for (const glm::vec3& p : Positions) {
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		Center = (min + max) * 0.5f;
+		return true;
+	}
+private:
+	uint32_t meshVersion = 0; // versions start from 1, 0 is never valid
+	uint32_t transformVersion = 0;
+};
+
+// World-space bounds of a rendered mesh and its leaf in the scene's spatial index. Maintained by the Scene.
+struct WorldBoundsComponent : public Component {
+	static const inline char* GetName() { return "WorldBoundsComponent"; }
+
+	glm::vec3 Min = { 0.0f, 0.0f, 0.0f };
+	glm::vec3 Max = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f; // of the bounding sphere around the box center
+	int32_t Proxy = -1;
+};
+
 struct LineGeneratorComponent : public Component {
 	static const inline char* GetName() { return "LineGeneratorComponent"; }
 
@@ -314,7 +473,7 @@ struct LineGeneratorComponent : public Component {
 		CalculateVertices();
 	}
 
-	std::shared_ptr<VertexArray>& GetVertexArray() { return vertexArray; }
+	const std::vector<glm::vec3>& GetVertices() const { return Vertices; }
 
 	void CalculateVertices() {
 		Vertices.clear();
@@ -356,13 +515,9 @@ struct LineGeneratorComponent : public Component {
 		}
 		break;
 		}
-		auto lc = LineComponent(Vertices);
-		lc.ComputeVertexArray();
-		vertexArray = lc.GetVertexArray();
 	}
 private:
 	std::vector<glm::vec3> Vertices;
-	std::shared_ptr<VertexArray> vertexArray = nullptr;
 };
 
 class LightComponent : public Component {
@@ -370,6 +525,7 @@ public:
 	static const inline char* GetName() { return "LightComponent"; }
 public:
 	float intensity = 1.0f;
+	float range = 0.0f; // no effect beyond it, 0 for unlimited. Limited lights only reach the clusters they overlap.
 };
 
 
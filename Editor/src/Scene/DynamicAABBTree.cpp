@@ -0,0 +1,337 @@
+#include "DynamicAABBTree.h"
+
+#include <algorithm>
+#include <cassert>
+
+static float SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 d = max - min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool Contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax) {
+	return glm::all(glm::lessThanEqual(outerMin, innerMin)) && glm::all(glm::lessThanEqual(innerMax, outerMax));
+}
+
+static bool Overlaps(const DynamicAABBTree::Node& node, const glm::vec3& min, const glm::vec3& max) {
+	return glm::all(glm::lessThanEqual(node.min, max)) && glm::all(glm::lessThanEqual(min, node.max));
+}
+
+// same on all axes, so that flat boxes get some room too
+static glm::vec3 Margin(float fatMargin, const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 size = max - min;
+	return glm::vec3(fatMargin * std::max({ size.x, size.y, size.z }));
+}
+
+int32_t DynamicAABBTree::AllocateNode() {
+	if (freeList < 0) {
+		nodes.emplace_back();
+		nodes.back().height = 0;
+		return (int32_t)nodes.size() - 1;
+	}
+	int32_t node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = Node();
+	nodes[node].height = 0;
+	return node;
+}
+
+void DynamicAABBTree::FreeNode(int32_t node) {
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+int32_t DynamicAABBTree::CreateProxy(const glm::vec3& min, const glm::vec3& max, uint32_t userData) {
+	int32_t proxy = AllocateNode();
+	glm::vec3 margin = Margin(fatMargin, min, max);
+	nodes[proxy].min = min - margin;
+	nodes[proxy].max = max + margin;
+	nodes[proxy].userData = userData;
+	InsertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int32_t proxy) {
+	assert(proxy >= 0 && proxy < (int32_t)nodes.size() && nodes[proxy].IsLeaf());
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+bool DynamicAABBTree::MoveProxy(int32_t proxy, const glm::vec3& min, const glm::vec3& max) {
+	assert(proxy >= 0 && proxy < (int32_t)nodes.size() && nodes[proxy].IsLeaf());
+	glm::vec3 margin = Margin(fatMargin, min, max);
+	glm::vec3 fatMin = min - margin, fatMax = max + margin;
+	// also refatten boxes that became much larger than the object, e.g. after it shrank
+	const Node& node = nodes[proxy];
+	bool isEnclosed = Contains(node.min, node.max, min, max);
+	bool isTooLarge = !Contains(fatMin - 4.0f * margin, fatMax + 4.0f * margin, node.min, node.max);
+	if (isEnclosed && !isTooLarge) return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].min = fatMin;
+	nodes[proxy].max = fatMax;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAABBTree::Clear() {
+	nodes.clear();
+	root = -1;
+	freeList = -1;
+	proxyCount = 0;
+}
+
+void DynamicAABBTree::InsertLeaf(int32_t leaf) {
+	if (root < 0) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// Descend towards the sibling with the least increase in surface area, the cost of a subtree being the area of its boxes
+	const glm::vec3 leafMin = nodes[leaf].min, leafMax = nodes[leaf].max;
+	int32_t index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		float area = SurfaceArea(node.min, node.max);
+		float combinedArea = SurfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down, every ancestor grows
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; c++) {
+			const Node& child = nodes[c == 0 ? node.child1 : node.child2];
+			float childArea = SurfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+			childCosts[c] = (child.IsLeaf() ? childArea : childArea - SurfaceArea(child.min, child.max)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1]) break;
+		index = childCosts[0] < childCosts[1] ? node.child1 : node.child2;
+	}
+
+	const int32_t sibling = index;
+	const int32_t oldParent = nodes[sibling].parent;
+	const int32_t newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent < 0) {
+		root = newParent;
+	}
+	else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	}
+	else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(newParent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int32_t leaf) {
+	if (leaf == root) {
+		root = -1;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	const int32_t parent = nodes[leaf].parent;
+	const int32_t grandParent = nodes[parent].parent;
+	const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	FreeNode(parent);
+	nodes[sibling].parent = grandParent;
+	if (grandParent < 0) {
+		root = sibling;
+		return;
+	}
+	if (nodes[grandParent].child1 == parent) {
+		nodes[grandParent].child1 = sibling;
+	}
+	else {
+		nodes[grandParent].child2 = sibling;
+	}
+	Refit(grandParent);
+}
+
+void DynamicAABBTree::Refit(int32_t index) {
+	while (index >= 0) {
+		index = Balance(index);
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.min = glm::min(child1.min, child2.min);
+		node.max = glm::max(child1.max, child2.max);
+		node.height = 1 + std::max(child1.height, child2.height);
+		index = node.parent;
+	}
+}
+
+int32_t DynamicAABBTree::Balance(int32_t iA) {
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	// Rotate the taller child up. Its taller grandchild stays under it, the other one moves under A.
+	const int32_t iB = A.child1;
+	const int32_t iC = A.child2;
+	const int32_t balance = nodes[iC].height - nodes[iB].height;
+	if (balance >= -1 && balance <= 1) return iA;
+
+	const bool isRightHeavy = balance > 1;
+	const int32_t iUp = isRightHeavy ? iC : iB; // becomes the parent of A
+	const int32_t iOther = isRightHeavy ? iB : iC; // stays under A
+	Node& up = nodes[iUp];
+	const int32_t iF = up.child1;
+	const int32_t iG = up.child2;
+	const bool keepF = nodes[iF].height > nodes[iG].height;
+	const int32_t iKept = keepF ? iF : iG;
+	const int32_t iMoved = keepF ? iG : iF;
+
+	up.child1 = iA;
+	up.child2 = iKept;
+	up.parent = A.parent;
+	A.parent = iUp;
+	if (up.parent < 0) {
+		root = iUp;
+	}
+	else if (nodes[up.parent].child1 == iA) {
+		nodes[up.parent].child1 = iUp;
+	}
+	else {
+		nodes[up.parent].child2 = iUp;
+	}
+
+	if (isRightHeavy) A.child2 = iMoved;
+	else A.child1 = iMoved;
+	nodes[iMoved].parent = iA;
+
+	const Node& other = nodes[iOther];
+	const Node& moved = nodes[iMoved];
+	const Node& kept = nodes[iKept];
+	A.min = glm::min(other.min, moved.min);
+	A.max = glm::max(other.max, moved.max);
+	A.height = 1 + std::max(other.height, moved.height);
+	up.min = glm::min(A.min, kept.min);
+	up.max = glm::max(A.max, kept.max);
+	up.height = 1 + std::max(A.height, kept.height);
+	return iUp;
+}
+
+void DynamicAABBTree::QueryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& out) const {
+	if (root < 0) return;
+
+	glm::vec3 absNormals[6];
+	for (int p = 0; p < 6; p++) {
+		absNormals[p] = glm::abs(glm::vec3(planes[p]));
+	}
+
+	// subtrees entirely inside the frustum are collected without further plane tests
+	struct Entry {
+		int32_t node;
+		bool isInside;
+	};
+	std::vector<Entry> stack;
+	stack.push_back({ root, false });
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[entry.node];
+
+		bool isInside = entry.isInside;
+		if (!isInside) {
+			glm::vec3 center = 0.5f * (node.min + node.max);
+			glm::vec3 extent = 0.5f * (node.max - node.min);
+			bool isOutside = false;
+			isInside = true;
+			for (int p = 0; p < 6 && !isOutside; p++) {
+				float distance = glm::dot(glm::vec3(planes[p]), center) + planes[p].w;
+				float radius = glm::dot(absNormals[p], extent);
+				isOutside = distance + radius < 0.0f;
+				isInside &= distance - radius >= 0.0f;
+			}
+			if (isOutside) continue;
+		}
+
+		if (node.IsLeaf()) {
+			out.push_back(node.userData);
+		}
+		else {
+			stack.push_back({ node.child1, isInside });
+			stack.push_back({ node.child2, isInside });
+		}
+	}
+}
+
+void DynamicAABBTree::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const {
+	if (root < 0) return;
+
+	std::vector<int32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!Overlaps(node, min, max)) continue;
+
+		if (node.IsLeaf()) {
+			out.push_back(node.userData);
+		}
+		else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+void DynamicAABBTree::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+	if (root < 0) return;
+
+	std::vector<int32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		glm::vec3 d = glm::clamp(center, node.min, node.max) - center;
+		if (glm::dot(d, d) > radius * radius) continue;
+
+		if (node.IsLeaf()) {
+			out.push_back(node.userData);
+		}
+		else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+void DynamicAABBTree::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& out) const {
+	if (root < 0) return;
+
+	// slab test, division by zero gives infinities that compare correctly unless the origin is on a slab boundary
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	std::vector<int32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		glm::vec3 t1 = (node.min - origin) * inverseDirection;
+		glm::vec3 t2 = (node.max - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float enter = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+		float exit = std::min({ tFar.x, tFar.y, tFar.z, maxDistance });
+		if (enter > exit) continue;
+
+		if (node.IsLeaf()) {
+			out.push_back(node.userData);
+		}
+		else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
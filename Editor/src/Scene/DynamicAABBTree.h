@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Bounding volume hierarchy over moving boxes, kept balanced with AVL rotations.
+// Leaves store boxes fattened by a margin so that small motions don't need a reinsertion.
+// Insert, remove and move are logarithmic, queries are logarithmic plus the number of results.
+class DynamicAABBTree {
+public:
+	struct Node {
+		glm::vec3 min;
+		glm::vec3 max;
+		int32_t parent = -1; // next free node while the node is in the free list
+		int32_t child1 = -1;
+		int32_t child2 = -1;
+		int32_t height = -1; // 0 for leaves, -1 for free nodes
+		uint32_t userData = 0;
+
+		bool IsLeaf() const { return child1 < 0; }
+	};
+
+	DynamicAABBTree() = default;
+
+	// Returns the proxy id of the new leaf. Ids stay valid until the proxy is destroyed.
+	int32_t CreateProxy(const glm::vec3& min, const glm::vec3& max, uint32_t userData);
+	void DestroyProxy(int32_t proxy);
+	// Reinserts the proxy only when the new box is not contained in its fat box. Returns true when it was reinserted.
+	bool MoveProxy(int32_t proxy, const glm::vec3& min, const glm::vec3& max);
+	uint32_t GetUserData(int32_t proxy) const { return nodes[proxy].userData; }
+	const Node& GetNode(int32_t proxy) const { return nodes[proxy]; }
+
+	// Queries append the user data of leaves whose fat boxes pass the test to out
+	// planes as from Math::ExtractFrustumPlanes, inside when dot(plane.xyz, p) + plane.w >= 0
+	void QueryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& out) const;
+	void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+	// Boxes hit by the segment from origin to origin + maxDistance * direction. direction does not need to be normalized.
+	void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& out) const;
+
+	int32_t GetHeight() const { return root < 0 ? 0 : nodes[root].height; }
+	uint32_t GetProxyCount() const { return proxyCount; }
+	void Clear();
+public:
+	// fraction of a box's size added on each side of leaf boxes
+	float fatMargin = 0.1f;
+private:
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	int32_t Balance(int32_t node);
+	// Recomputes boxes and heights from node up to the root, rebalancing on the way
+	void Refit(int32_t node);
+private:
+	std::vector<Node> nodes;
+	int32_t root = -1;
+	int32_t freeList = -1;
+	uint32_t proxyCount = 0;
+};
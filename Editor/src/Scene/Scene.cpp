@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <map>
 
@@ -7,8 +8,40 @@
 #include <glm/glm.hpp>
 
 #include "Components.h"
+#include "../Math.h"
+#include "../ThreadPool.h"
+#include "../Renderer/MeshLODCache.h"
 #include "../Renderer/Renderer.h"
 
+static MeshComponent* GetMesh(entt::handle handle) {
+	if (handle.all_of<MeshComponent>()) {
+		return &handle.get<MeshComponent>();
+	}
+	else if (handle.all_of<MeshObjLoaderComponent>()) {
+		return &handle.get<MeshObjLoaderComponent>().meshComponent;
+	}
+	assert(false); // An entity with MeshRendererComponent should either have MeshComponent or a MeshObjLoaderComponent
+	return nullptr;
+}
+
+// Diameter of the bounding sphere relative to the viewport height
+static float ProjectedSize(const WorldBoundsComponent& bounds, const glm::vec3& cameraPosition, const glm::mat4& projection) {
+	const bool isPerspective = projection[3][3] == 0.0f;
+	float distance = isPerspective ? std::max(glm::length(0.5f * (bounds.Min + bounds.Max) - cameraPosition), bounds.Radius) : 1.0f;
+	return bounds.Radius * projection[1][1] / distance;
+}
+
+void Scene::OnBoundsChanged(entt::registry&, entt::entity entity) {
+	boundsDirtyEntities.push_back(entity);
+}
+
+void Scene::OnWorldBoundsDestroyed(entt::registry& registry, entt::entity entity) {
+	WorldBoundsComponent& bounds = registry.get<WorldBoundsComponent>(entity);
+	if (bounds.Proxy >= 0) {
+		spatialIndex.DestroyProxy(bounds.Proxy);
+	}
+}
+
 void Scene::OnCameraCreated(entt::registry& registry, entt::entity entity) {
 	CameraComponent& cc = registry.get<CameraComponent>(entity);
 	cc.Camera.SetViewportSize(viewportWidth, viewportHeight);
@@ -25,10 +58,24 @@ void Scene::OnMeshObjLoaderCreated(entt::registry& registry, entt::entity entity
 	comp.meshComponent.entityID = (int)entity;
 }
 
+void Scene::OnMeshObjLoaderDestroyed(entt::registry& registry, entt::entity entity) {
+	registry.remove_if_exists<MeshLODComponent>(entity);
+}
+
 Scene::Scene() {
 	Registry.on_construct<CameraComponent>().connect<&Scene::OnCameraCreated>(this);
 	Registry.on_construct<MeshComponent>().connect<&Scene::OnMeshCreated>(this);
 	Registry.on_construct<MeshObjLoaderComponent>().connect<&Scene::OnMeshObjLoaderCreated>(this);
+	Registry.on_destroy<MeshObjLoaderComponent>().connect<&Scene::OnMeshObjLoaderDestroyed>(this);
+	Registry.on_construct<TransformComponent>().connect<&Scene::OnHierarchyChanged>(this);
+	Registry.on_destroy<TransformComponent>().connect<&Scene::OnHierarchyChanged>(this);
+	transformObserver.connect(Registry, entt::collector.update<TransformComponent>());
+	Registry.on_construct<MeshRendererComponent>().connect<&Scene::OnBoundsChanged>(this);
+	Registry.on_destroy<MeshRendererComponent>().connect<&Scene::OnBoundsChanged>(this);
+	Registry.on_update<MeshComponent>().connect<&Scene::OnBoundsChanged>(this);
+	Registry.on_update<MeshObjLoaderComponent>().connect<&Scene::OnBoundsChanged>(this);
+	Registry.on_destroy<WorldBoundsComponent>().connect<&Scene::OnWorldBoundsDestroyed>(this);
+	occlusionBuffer.Resize(occlusionBufferWidth, occlusionBufferWidth * viewportHeight / viewportWidth);
 }
 
 Scene::~Scene() {
@@ -45,79 +92,305 @@ entt::entity Scene::CreateEntity(const std::string& name) {
 }
 
 void Scene::DestroyEntity(entt::entity entity) {
+	// copies, destroying children modifies the relationship
+	entt::entity parent = GetParent(entity);
+	std::vector<entt::entity> children;
+	if (auto* relationship = Registry.try_get<RelationshipComponent>(entity)) {
+		children = relationship->Children;
+	}
+
+	if (parent != entt::null) {
+		RemoveChild(parent, entity);
+	}
+	for (entt::entity child : children) {
+		DestroyEntity(child);
+	}
 	Registry.destroy(entity);
 }
 
+void Scene::OnHierarchyChanged(entt::registry&, entt::entity) {
+	isHierarchyDirty = true;
+}
+
+entt::entity Scene::GetParent(entt::entity entity) {
+	auto* relationship = Registry.try_get<RelationshipComponent>(entity);
+	return relationship ? relationship->Parent : entt::null;
+}
+
+bool Scene::IsDescendantOf(entt::entity entity, entt::entity ancestor) {
+	for (entt::entity e = GetParent(entity); e != entt::null; e = GetParent(e)) {
+		if (e == ancestor) return true;
+	}
+	return false;
+}
+
+glm::mat4 Scene::GetParentTransform(entt::entity entity) {
+	entt::entity parent = GetParent(entity);
+	return parent == entt::null ? glm::mat4(1.0f) : Registry.get<TransformComponent>(parent).GetTransform();
+}
+
+void Scene::RemoveChild(entt::entity parent, entt::entity child) {
+	std::vector<entt::entity>& siblings = Registry.get<RelationshipComponent>(parent).Children;
+	siblings.erase(std::remove(siblings.begin(), siblings.end(), child), siblings.end());
+	isHierarchyDirty = true;
+}
+
+void Scene::SetParent(entt::entity child, entt::entity parent, bool keepWorldTransform) {
+	if (child == parent || (parent != entt::null && IsDescendantOf(parent, child))) {
+		std::cerr << "An entity can't be parented to itself or to one of its descendants." << std::endl;
+		return;
+	}
+	entt::entity oldParent = GetParent(child);
+	if (oldParent == parent) return;
+
+	const glm::mat4 worldTransform = Registry.get<TransformComponent>(child).GetTransform();
+	if (oldParent != entt::null) {
+		RemoveChild(oldParent, child);
+	}
+	// emplace parent's first, emplacing can move child's RelationshipComponent
+	if (parent != entt::null) {
+		Registry.get_or_emplace<RelationshipComponent>(parent).Children.push_back(child);
+	}
+	Registry.get_or_emplace<RelationshipComponent>(child).Parent = parent;
+
+	TransformComponent& tc = Registry.get<TransformComponent>(child);
+	if (keepWorldTransform) {
+		glm::mat4 localTransform = glm::inverse(GetParentTransform(child)) * worldTransform;
+		Math::DecomposeTransform(localTransform, tc.Translation, tc.Rotation, tc.Scale);
+	}
+	Registry.patch<TransformComponent>(child);
+	isHierarchyDirty = true;
+}
+
+void Scene::RebuildTransformLevels() {
+	// the previous levels tell which nodes are new or have a new parent
+	std::vector<TransformNode> oldNodes = std::move(transformNodes);
+	std::unordered_map<entt::entity, uint32_t> oldNodeOfEntity = std::move(transformNodeOfEntity);
+	std::vector<uint8_t> oldNodeDirty = std::move(transformNodeDirty);
+	transformNodes.clear();
+	transformLevelStarts.clear();
+	transformNodeOfEntity.clear();
+
+	auto view = Registry.view<TransformComponent>();
+	for (entt::entity entity : view) {
+		if (GetParent(entity) == entt::null) {
+			transformNodes.push_back({ entity, -1 });
+		}
+	}
+	// breadth-first, children of a level are appended as the next level
+	uint32_t levelBegin = 0;
+	transformLevelStarts.push_back(levelBegin);
+	while (levelBegin < transformNodes.size()) {
+		uint32_t levelEnd = (uint32_t)transformNodes.size();
+		for (uint32_t i = levelBegin; i < levelEnd; i++) {
+			if (auto* relationship = Registry.try_get<RelationshipComponent>(transformNodes[i].entity)) {
+				for (entt::entity child : relationship->Children) {
+					transformNodes.push_back({ child, (int32_t)i });
+				}
+			}
+		}
+		transformLevelStarts.push_back(levelEnd);
+		levelBegin = levelEnd;
+	}
+
+	// only new and reparented nodes are dirty, besides those that already were. Their descendants follow in UpdateTransforms.
+	transformNodeDirty.assign(transformNodes.size(), 1);
+	for (uint32_t i = 0; i < transformNodes.size(); i++) {
+		const TransformNode& node = transformNodes[i];
+		transformNodeOfEntity[node.entity] = i;
+		auto it = oldNodeOfEntity.find(node.entity);
+		if (it == oldNodeOfEntity.end()) continue;
+		const TransformNode& oldNode = oldNodes[it->second];
+		const entt::entity parent = node.parent >= 0 ? transformNodes[node.parent].entity : entt::null;
+		const entt::entity oldParent = oldNode.parent >= 0 ? oldNodes[oldNode.parent].entity : entt::null;
+		transformNodeDirty[i] = oldNodeDirty[it->second] || parent != oldParent;
+	}
+	isHierarchyDirty = false;
+}
+
+// Recomputes cached matrices of only the transforms that were patched since last frame and their descendants.
+// Levels are processed in order, nodes within a level in parallel.
+void Scene::UpdateTransforms() {
+	lastTransformUpdateCount = 0;
+	if (isHierarchyDirty) {
+		RebuildTransformLevels();
+	}
+	else if (transformObserver.empty()) {
+		return;
+	}
+	for (const entt::entity entity : transformObserver) {
+		auto it = transformNodeOfEntity.find(entity);
+		if (it != transformNodeOfEntity.end()) {
+			transformNodeDirty[it->second] = 1;
+		}
+	}
+	transformObserver.clear();
+
+	const uint32_t minNodesPerChunk = 4096;
+	auto view = Registry.view<TransformComponent>();
+	std::vector<uint32_t> updateCounts;
+	for (size_t level = 0; level + 1 < transformLevelStarts.size(); level++) {
+		const uint32_t levelBegin = transformLevelStarts[level];
+		const uint32_t levelSize = transformLevelStarts[level + 1] - levelBegin;
+		const uint32_t numChunks = std::max(1u, std::min(ThreadPool::Instance().GetThreadCount(), levelSize / minNodesPerChunk));
+		const uint32_t chunkSize = (levelSize + numChunks - 1) / numChunks;
+		updateCounts.assign(numChunks, 0);
+		ThreadPool::Instance().ParallelFor(numChunks, [&](uint32_t chunk) {
+			// gather dirty nodes of the chunk, compose their local matrices in one SIMD batch, then apply parents
+			thread_local std::vector<uint32_t> dirtyNodes;
+			thread_local Math::TRSArrays trs;
+			thread_local std::vector<glm::mat4> localTransforms;
+			dirtyNodes.clear();
+			uint32_t end = levelBegin + std::min(levelSize, (chunk + 1) * chunkSize);
+			for (uint32_t i = levelBegin + chunk * chunkSize; i < end; i++) {
+				const TransformNode& node = transformNodes[i];
+				if (node.parent >= 0 && transformNodeDirty[node.parent]) {
+					transformNodeDirty[i] = 1;
+				}
+				if (transformNodeDirty[i]) {
+					dirtyNodes.push_back(i);
+				}
+			}
+
+			trs.Resize(dirtyNodes.size());
+			for (size_t k = 0; k < dirtyNodes.size(); k++) {
+				const TransformComponent& tc = view.get<TransformComponent>(transformNodes[dirtyNodes[k]].entity);
+				trs.Set(k, tc.Translation, tc.Rotation, tc.Scale);
+			}
+			localTransforms.resize(dirtyNodes.size());
+			Math::ComposeTransforms(trs, localTransforms.data());
+
+			for (size_t k = 0; k < dirtyNodes.size(); k++) {
+				const TransformNode& node = transformNodes[dirtyNodes[k]];
+				TransformComponent& tc = view.get<TransformComponent>(node.entity);
+				if (node.parent >= 0)
+					tc.UpdateCache(view.get<TransformComponent>(transformNodes[node.parent].entity).GetTransform(), localTransforms[k]);
+				else
+					tc.UpdateCache(glm::mat4(1.0f), localTransforms[k]);
+			}
+			updateCounts[chunk] = (uint32_t)dirtyNodes.size();
+		});
+		for (uint32_t count : updateCounts) {
+			lastTransformUpdateCount += count;
+		}
+	}
+	for (size_t i = 0; i < transformNodes.size(); i++) {
+		if (transformNodeDirty[i] && Registry.all_of<MeshRendererComponent>(transformNodes[i].entity)) {
+			boundsDirtyEntities.push_back(transformNodes[i].entity);
+		}
+	}
+	std::fill(transformNodeDirty.begin(), transformNodeDirty.end(), 0);
+}
+
+void Scene::UpdateBounds() {
+	if (boundsDirtyEntities.empty()) return;
+	std::sort(boundsDirtyEntities.begin(), boundsDirtyEntities.end());
+	boundsDirtyEntities.erase(std::unique(boundsDirtyEntities.begin(), boundsDirtyEntities.end()), boundsDirtyEntities.end());
+
+	meshEntities.clear();
+	for (entt::entity entity : boundsDirtyEntities) {
+		if (!Registry.valid(entity)) continue;
+		// no longer rendered, removing the bounds also removes the leaf
+		if (!Registry.all_of<TransformComponent, MeshRendererComponent>(entity)) {
+			Registry.remove_if_exists<WorldBoundsComponent>(entity);
+			continue;
+		}
+		meshEntities.push_back(entity);
+	}
+	boundsDirtyEntities.clear();
+
+	const size_t count = meshEntities.size();
+	meshLocalBounds.Resize(count);
+	meshWorldBounds.Resize(count);
+	meshWorldMatrices.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		entt::basic_handle handle = { Registry, meshEntities[i] };
+		const MeshComponent* mesh = GetMesh(handle);
+		meshLocalBounds.Set(i, mesh->BoundsMin, mesh->BoundsMax);
+		meshWorldMatrices[i] = handle.get<TransformComponent>().GetTransform();
+	}
+	Math::TransformAABBs(meshWorldMatrices.data(), meshLocalBounds, meshWorldBounds);
+
+	for (size_t i = 0; i < count; i++) {
+		entt::basic_handle handle = { Registry, meshEntities[i] };
+		const MeshComponent* mesh = GetMesh(handle);
+		const glm::mat4& transform = meshWorldMatrices[i];
+		WorldBoundsComponent& bounds = handle.get_or_emplace<WorldBoundsComponent>();
+		bounds.Min = { meshWorldBounds.minX[i], meshWorldBounds.minY[i], meshWorldBounds.minZ[i] };
+		bounds.Max = { meshWorldBounds.maxX[i], meshWorldBounds.maxY[i], meshWorldBounds.maxZ[i] };
+		// a sphere stays a sphere under the largest scale of the transform
+		float maxScale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+		bounds.Radius = mesh->BoundingSphereRadius * maxScale;
+		if (bounds.Proxy < 0) {
+			bounds.Proxy = spatialIndex.CreateProxy(bounds.Min, bounds.Max, (uint32_t)meshEntities[i]);
+		}
+		else {
+			spatialIndex.MoveProxy(bounds.Proxy, bounds.Min, bounds.Max);
+		}
+	}
+}
+
 void Scene::OnUpdate(Timestep ts, EditorCamera& editorCamera) {
-	RenderCommand::Init(renderWireframe, renderOnlyFront);
+	UpdateTransforms();
+	UpdateBounds();
+	UpdateLODs();
+	RenderCommand::BeginFrame(renderWireframe, renderOnlyFront);
 
 	std::vector<Renderer::LightInfo> lightInfos;
 	auto viewLights = Registry.view<TransformComponent, LightComponent>();
 	for (auto [entity, transform, light] : viewLights.each()) {
-		lightInfos.push_back({transform.Translation, light.intensity});
+		lightInfos.push_back({glm::vec3(transform.GetTransform()[3]), light.intensity, light.range});
 	}
  
 	Camera* sceneCamera = nullptr;
 	glm::mat4 cameraTransform;
-	glm::vec3 cameraTranslation;
 	{
 		auto view = Registry.view<TransformComponent, CameraComponent>();
 		for (auto [entity, transform, camera] : view.each()) {
 			if (camera.Primary) {
 				sceneCamera = &camera.Camera;
 				cameraTransform = transform.GetTransform();
-				cameraTranslation = transform.Translation;
 				break;
 			}
 		}
 	}
+	Renderer::SetMultiDrawEnabled(enableMultiDraw);
 	if (sceneCamera) {
 		Renderer::BeginScene(sceneCamera->GetProjection(), cameraTransform, lightInfos);
 	}
 	else {
 		Renderer::BeginScene(editorCamera.GetProjection(), editorCamera.GetViewMatrix(), lightInfos);
-		cameraTranslation = editorCamera.GetPosition();
 	}
 	
 	auto view2 = Registry.view<TransformComponent, LineComponent, LineRendererComponent>();
 	for (auto [entity, transform, line, lineRenderer] : view2.each()) {
-		Renderer::DrawLines(line.GetVertexArray(), transform.GetTransform(), lineRenderer.Color, lineRenderer.IsLooped);
+		Renderer::DrawLines(line.Vertices, transform.GetTransform(), lineRenderer.Color, lineRenderer.IsLooped, (int)entity);
 	}
 
 	auto view3 = Registry.view<TransformComponent, LineGeneratorComponent, LineRendererComponent>();
 	for (auto [entity, transform, line, lineRenderer] : view3.each()) {
-		Renderer::DrawLines(line.GetVertexArray(), transform.GetTransform(), lineRenderer.Color, lineRenderer.IsLooped);
-	}
-
-	auto view4 = Registry.view<TransformComponent, MeshRendererComponent>();
-	class TriangleParams {
-	public:
-		MeshComponent* mesh;
-		MeshRendererComponent* meshRenderer;
-		std::shared_ptr<Shader> shader;
-		TransformComponent* transform;
-		uint32_t triangleNo;
-		float dist = 100000.0f;
-
-		TriangleParams(const TriangleParams&) = default;
-	};
-	std::vector<TriangleParams> triangles;
-	glDepthMask(GL_TRUE);
-	for (auto [entity, transform, meshRenderer] : view4.each()) {
-		std::shared_ptr<Shader> shader = renderFlatShading ?
-			ShaderLibrary::Instance().Get("FlatShader") :
-			ShaderLibrary::Instance().Get("SolidColor");
+		Renderer::DrawLines(line.GetVertices(), transform.GetTransform(), lineRenderer.Color, lineRenderer.IsLooped, (int)entity);
+	}
 
+	CullMeshes();
+	std::shared_ptr<Shader> shader = renderFlatShading ?
+		ShaderLibrary::Instance().Get("FlatShader") :
+		ShaderLibrary::Instance().Get("SolidColor");
+	RenderCommand::SetDepthMask(true);
+	Renderer::BeginTransparentBatch(transparencyMode);
+	for (entt::entity entity : visibleMeshEntities) {
 		entt::basic_handle handle = { Registry, entity };
-		MeshComponent* mesh = nullptr;
-		if (handle.all_of<MeshComponent>()) {
-			mesh = &handle.get<MeshComponent>();
-		}
-		else if (handle.all_of<MeshObjLoaderComponent>()) {
-			mesh = &handle.get<MeshObjLoaderComponent>().meshComponent;
-		}
-		else {
-			assert(false); // An entity with MeshRendererComponent should either have MeshComponent or a MeshObjLoaderComponent
+		TransformComponent& transform = handle.get<TransformComponent>();
+		MeshRendererComponent& meshRenderer = handle.get<MeshRendererComponent>();
+		MeshComponent* mesh = GetMesh(handle);
+		if (MeshLODComponent* lod = handle.try_get<MeshLODComponent>()) {
+			const WorldBoundsComponent* bounds = handle.try_get<WorldBoundsComponent>();
+			lod->CurrentLOD = SelectLOD(*lod, bounds ? ProjectedSize(*bounds, Renderer::GetCameraPosition(), Renderer::GetProjection()) : 1.0f);
+			if (lod->CurrentLOD > 0 && lod->sourceVersion == mesh->version) {
+				MeshComponent* lodMesh = &lod->Levels[lod->CurrentLOD - 1];
+				RenderCommand::frameStats.trianglesSavedByLOD += (int)(mesh->Indices.size() - lodMesh->Indices.size());
+				mesh = lodMesh;
+			}
 		}
 
 		// Render opaque objects one draw call per mesh using regular depth buffer
@@ -125,40 +398,159 @@ void Scene::OnUpdate(Timestep ts, EditorCamera& editorCamera) {
 			Renderer::DrawMesh(*mesh, meshRenderer, shader, transform);
 		}
 
-		// store transparent object triangles in a vector
+		// collect transparent object triangles into the transparent batch
+		// world-space positions are recomputed only when the mesh or transform changed since last frame
 		else {
-			int indexCount = mesh->vertexArray->GetIndexBuffer()->GetCount();
-			int numTriangles = indexCount / 3;
-			for (int i = 0; i < numTriangles; i++) {
-				float minDistOfTriangle = 1000000.0f;
-				glm::uvec3 triangleVertexIndices = mesh->Indices[i];
-				for (int j = 0; j < 3; j++) {
-					auto ix = triangleVertexIndices[j];
-					glm::vec3& v = mesh->Vertices[ix].Position;
-					glm::vec3 worldVertexPos = glm::vec3(transform.GetTransform() * glm::vec4{ v.x, v.y, v.z, 1.0 });
-					minDistOfTriangle = std::min(minDistOfTriangle, glm::length(worldVertexPos - cameraTranslation));
-				}
-				TriangleParams tp = TriangleParams{ mesh, &meshRenderer, shader, &transform, (uint32_t)i, minDistOfTriangle };
-				triangles.push_back(tp);
+			WorldMeshCacheComponent& worldMesh = handle.get_or_emplace<WorldMeshCacheComponent>();
+			worldMesh.Update(*mesh, transform);
+			Renderer::SubmitTransparentMesh(*mesh, meshRenderer, worldMesh);
+		}
+	}
+
+	// sort transparent triangles by distance to camera (or blend them order-independently)
+	// draw them in one call without writing to depth buffer
+	Renderer::EndTransparentBatch(shader, renderFlatShading);
+
+	Renderer::EndScene();
+}
+
+void Scene::UpdateLODs() {
+	auto view = Registry.view<MeshObjLoaderComponent, MeshRendererComponent>();
+	for (auto [entity, loader, meshRenderer] : view.each()) {
+		const MeshComponent& mesh = loader.meshComponent;
+		MeshLODComponent* lod = Registry.try_get<MeshLODComponent>(entity);
+		if (!lod && mesh.Indices.empty()) continue;
+		MeshLODComponent& newLOD = lod ? *lod : Registry.emplace<MeshLODComponent>(entity);
+		if (newLOD.sourceVersion == mesh.version) continue;
+
+		// Levels of the previous mesh are dropped right away, LOD 0 is drawn until the new chain is built
+		newLOD.Levels.clear();
+		newLOD.CurrentLOD = 0;
+		if (mesh.Indices.empty()) continue;
+
+		const std::string key = std::to_string(mesh.geometryHash);
+		auto chain = MeshLODCache::Instance().Request(key, &mesh.Vertices[0].Position, sizeof(MeshComponent::MeshVertex), mesh.Vertices.size(), mesh.Indices);
+		if (!chain) continue;
+
+		newLOD.sourceVersion = mesh.version;
+		newLOD.Levels.reserve(chain->size());
+		for (const MeshSimplifier::Level& level : *chain) {
+			MeshComponent& levelMesh = newLOD.Levels.emplace_back();
+			levelMesh.entityID = mesh.entityID;
+			levelMesh.UseBSP = mesh.UseBSP;
+			levelMesh.Vertices.clear();
+			for (const glm::vec3& p : level.Positions) {
+				levelMesh.Vertices.push_back({ p, mesh.entityID });
 			}
+			levelMesh.Indices = level.Triangles;
+			levelMesh.ComputeVertexArray();
 		}
 	}
+}
 
-	// sort transparent triangles by distance to camera
-	// draw them without writing to depth buffer
-	glDepthMask(GL_FALSE);
-	std::sort(triangles.rbegin(), triangles.rend(), 
-		[](const TriangleParams& tp1, const TriangleParams& tp2) { return tp1.dist < tp2.dist; });
-	for (TriangleParams& tp : triangles) {
-		Renderer::DrawMeshTriangle(*tp.mesh, *tp.meshRenderer, tp.shader, *tp.transform, tp.triangleNo);
+int Scene::SelectLOD(const MeshLODComponent& lod, float screenSize) const {
+	const int maxLOD = (int)lod.Levels.size();
+	if (lod.ForcedLOD >= 0) return std::min(lod.ForcedLOD, maxLOD);
+	if (forcedLOD >= 0) return std::min(forcedLOD, maxLOD);
+	if (!enableLOD) return 0;
+
+	// LOD i is used below lodScreenSize / 2^(i - 1). Going back up needs a margin so that meshes near a threshold don't flicker.
+	auto threshold = [&](int level) { return lodScreenSize * std::pow(0.5f, (float)(level - 1)); };
+	int level = std::min(lod.CurrentLOD, maxLOD);
+	while (level < maxLOD && screenSize < threshold(level + 1) * (1.0f - lodHysteresis)) level++;
+	while (level > 0 && screenSize > threshold(level) * (1.0f + lodHysteresis)) level--;
+	return level;
+}
+
+void Scene::CullMeshes() {
+	visibleMeshEntities.clear();
+	if (!enableFrustumCulling) {
+		auto view = Registry.view<TransformComponent, MeshRendererComponent>();
+		for (auto entity : view) {
+			visibleMeshEntities.push_back(entity);
+		}
+		RenderCommand::frameStats.visibleMeshes = (int)visibleMeshEntities.size();
+		return;
 	}
 
-	Renderer::EndScene();
+	// the tree gives candidates whose fat boxes intersect the frustum, exact boxes and screen sizes are tested in one batch
+	glm::vec4 planes[6];
+	Math::ExtractFrustumPlanes(Renderer::GetViewProjection(), planes);
+	meshCandidates.clear();
+	spatialIndex.QueryFrustum(planes, meshCandidates);
+
+	const size_t count = meshCandidates.size();
+	meshWorldBounds.Resize(count);
+	meshWorldRadii.resize(count);
+	meshVisible.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const WorldBoundsComponent& bounds = Registry.get<WorldBoundsComponent>((entt::entity)meshCandidates[i]);
+		meshWorldBounds.Set(i, bounds.Min, bounds.Max);
+		meshWorldRadii[i] = bounds.Radius;
+	}
+
+	const glm::mat4& projection = Renderer::GetProjection();
+	// screen size test only makes sense for perspective projections
+	const bool isPerspective = projection[3][3] == 0.0f;
+	Math::CullBounds(planes, meshWorldBounds, meshWorldRadii.data(), Renderer::GetCameraPosition(), projection[1][1], isPerspective ? minScreenSize : 0.0f, meshVisible.data());
+
+	int occludedCount = 0;
+	if (enableOcclusionCulling) {
+		occludedCount = CullOccludedMeshes(projection);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (meshVisible[i]) visibleMeshEntities.push_back((entt::entity)meshCandidates[i]);
+	}
+	RenderCommand::frameStats.visibleMeshes = (int)visibleMeshEntities.size();
+	RenderCommand::frameStats.occludedMeshes = occludedCount;
+	RenderCommand::frameStats.culledMeshes = (int)(spatialIndex.GetProxyCount() - visibleMeshEntities.size()) - occludedCount;
+}
+
+int Scene::CullOccludedMeshes(const glm::mat4& projection) {
+	// occluders are the visible opaque meshes covering the most of the screen, within a triangle budget
+	const glm::vec3& cameraPosition = Renderer::GetCameraPosition();
+	std::vector<std::pair<float, uint32_t>> occluderCandidates;
+	for (uint32_t i = 0; i < (uint32_t)meshCandidates.size(); i++) {
+		if (!meshVisible[i]) continue;
+		entt::entity entity = (entt::entity)meshCandidates[i];
+		if (Registry.get<MeshRendererComponent>(entity).IsTransparent) continue;
+		float screenSize = ProjectedSize(Registry.get<WorldBoundsComponent>(entity), cameraPosition, projection);
+		if (screenSize >= occluderMinScreenSize) {
+			occluderCandidates.push_back({ screenSize, i });
+		}
+	}
+	std::sort(occluderCandidates.begin(), occluderCandidates.end(), std::greater<>());
+
+	occlusionBuffer.Begin(Renderer::GetViewProjection());
+	uint32_t triangleCount = 0;
+	for (const auto& [screenSize, i] : occluderCandidates) {
+		entt::basic_handle handle = { Registry, (entt::entity)meshCandidates[i] };
+		const MeshComponent* mesh = GetMesh(handle);
+		if (mesh->Vertices.empty()) continue;
+		if (triangleCount > 0 && triangleCount + mesh->Indices.size() > occluderTriangleBudget) continue;
+		triangleCount += (uint32_t)mesh->Indices.size();
+		occlusionBuffer.AddOccluder(handle.get<TransformComponent>().GetTransform(), &mesh->Vertices[0].Position, sizeof(MeshComponent::MeshVertex), mesh->Indices.data(), mesh->Indices.size());
+	}
+	if (triangleCount == 0) return 0;
+	occlusionBuffer.Rasterize();
+
+	int occludedCount = 0;
+	for (size_t i = 0; i < meshCandidates.size(); i++) {
+		if (!meshVisible[i]) continue;
+		const WorldBoundsComponent& bounds = Registry.get<WorldBoundsComponent>((entt::entity)meshCandidates[i]);
+		if (!occlusionBuffer.IsVisible(bounds.Min, bounds.Max)) {
+			meshVisible[i] = 0;
+			occludedCount++;
+		}
+	}
+	return occludedCount;
 }
 
 void Scene::OnViewportResize(uint32_t width, uint32_t height) {
 	viewportWidth = width;
 	viewportHeight = height;
+	occlusionBuffer.Resize(occlusionBufferWidth, occlusionBufferWidth * height / std::max(width, 1u));
 
 	// Resize Our non-fixed aspect ratio cameras
 	auto view = Registry.view<CameraComponent>();
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "entt/entt.hpp"
 
 #include "Components.h"
+#include "DynamicAABBTree.h"
+#include "../Math.h"
 #include "../Timestep.h"
 #include "../Renderer/EditorCamera.h"
+#include "../Renderer/OcclusionBuffer.h"
+#include "../Renderer/Renderer.h"
 
 class Scene {
 public:
@@ -14,23 +20,96 @@ public:
 	~Scene();
 
 	entt::entity CreateEntity(const std::string& name = std::string());
+	// Also destroys its descendants
 	void DestroyEntity(entt::entity entity);
 
+	// parent can be entt::null to make child a root. With keepWorldTransform, child's local transform is changed so that it does not move.
+	void SetParent(entt::entity child, entt::entity parent, bool keepWorldTransform = true);
+	entt::entity GetParent(entt::entity entity);
+	bool IsDescendantOf(entt::entity entity, entt::entity ancestor);
+	// World transform of the parent, identity for roots
+	glm::mat4 GetParentTransform(entt::entity entity);
+
 	entt::registry& Reg() { return Registry; }
 
 	void OnUpdate(Timestep ts, EditorCamera& editorCamera);
 	void OnViewportResize(uint32_t width, uint32_t height);
 
 	entt::entity GetPrimaryCameraEntity();
+	// Number of transforms whose cached matrices were recomputed in the last OnUpdate
+	uint32_t GetLastTransformUpdateCount() const { return lastTransformUpdateCount; }
+	// Bounding volume hierarchy over the world bounds of rendered meshes, user data of leaves are entities. Up to date after OnUpdate.
+	const DynamicAABBTree& GetSpatialIndex() const { return spatialIndex; }
 	bool renderWireframe = false;
 	bool renderOnlyFront = false;
 	bool renderFlatShading = true;
+	Renderer::TransparencyMode transparencyMode = Renderer::TransparencyMode::SortedTriangles;
+	bool enableFrustumCulling = true;
+	// meshes whose bounding sphere covers less than this fraction of the viewport height are culled. 0 disables it.
+	float minScreenSize = 0.0f;
+	// meshes entirely behind large opaque meshes, rasterized on the CPU, are not drawn
+	bool enableOcclusionCulling = true;
+	float occluderMinScreenSize = 0.2f;
+	uint32_t occluderTriangleBudget = 100000;
+	// loaded meshes switch to coarser LODs as their projected size gets smaller
+	bool enableLOD = true;
+	float lodScreenSize = 0.5f; // LOD 1 is used below this, each next LOD below half of the previous size
+	float lodHysteresis = 0.1f;
+	int forcedLOD = -1; // uses this LOD for all meshes when not negative
+	// opaque meshes are drawn from a shared geometry arena with one multi-draw per shader
+	bool enableMultiDraw = true;
 private:
 	void OnCameraCreated(entt::registry& registry, entt::entity entity);
 	void OnMeshCreated(entt::registry& registry, entt::entity entity);
 	void OnMeshObjLoaderCreated(entt::registry& registry, entt::entity entity);
+	void OnMeshObjLoaderDestroyed(entt::registry& registry, entt::entity entity);
+	void OnHierarchyChanged(entt::registry& registry, entt::entity entity);
+	void OnBoundsChanged(entt::registry& registry, entt::entity entity);
+	void OnWorldBoundsDestroyed(entt::registry& registry, entt::entity entity);
+	void RemoveChild(entt::entity parent, entt::entity child);
+	void RebuildTransformLevels();
+	void UpdateTransforms();
+	// Recomputes world bounds of meshes whose geometry or transform changed and moves their leaves in the spatial index
+	void UpdateBounds();
+	// Fills visibleMeshEntities with the entities of MeshRendererComponents whose bounds intersect the view frustum of the current scene
+	void CullMeshes();
+	// Clears meshVisible of frustum culling candidates hidden by the largest visible meshes, returns how many
+	int CullOccludedMeshes(const glm::mat4& projection);
+	// Makes LOD levels of loaded meshes whose chain got built or whose mesh changed
+	void UpdateLODs();
+	int SelectLOD(const MeshLODComponent& lod, float screenSize) const;
 private:
 	entt::registry Registry;
+	// collects entities whose TransformComponent was patched since the last UpdateTransforms
+	entt::observer transformObserver;
+	uint32_t lastTransformUpdateCount = 0;
+
+	// Transform hierarchy flattened breadth-first, so that nodes of a depth level are contiguous and come after their parents
+	struct TransformNode {
+		entt::entity entity;
+		int32_t parent; // index into transformNodes, -1 for roots
+	};
+	std::vector<TransformNode> transformNodes;
+	std::vector<uint32_t> transformLevelStarts; // level i is [transformLevelStarts[i], transformLevelStarts[i + 1])
+	std::vector<uint8_t> transformNodeDirty;
+	std::unordered_map<entt::entity, uint32_t> transformNodeOfEntity;
+	bool isHierarchyDirty = true;
+
+	DynamicAABBTree spatialIndex;
+	// entities whose world bounds need an update, may contain duplicates and destroyed entities
+	std::vector<entt::entity> boundsDirtyEntities;
+
+	// bounds update and culling inputs and outputs, kept across frames to reuse their memory
+	std::vector<entt::entity> meshEntities;
+	std::vector<glm::mat4> meshWorldMatrices;
+	std::vector<float> meshWorldRadii;
+	std::vector<uint8_t> meshVisible;
+	std::vector<uint32_t> meshCandidates;
+	Math::AABBArrays meshLocalBounds;
+	Math::AABBArrays meshWorldBounds;
+	std::vector<entt::entity> visibleMeshEntities;
+	OcclusionBuffer occlusionBuffer;
+	static const uint32_t occlusionBufferWidth = 256;
 	// hack to prevent division by zero before first computation
 	uint32_t viewportWidth = 1, viewportHeight = 1;
 	
@@ -21,9 +21,19 @@ void SceneHierarchyPanel::SetContext(const std::shared_ptr<Scene> scene) {
 
 void SceneHierarchyPanel::OnImguiRender() {
 	ImGui::Begin("Scene Hierarchy");
+	// children are drawn under their parents
+	std::vector<entt::entity> roots;
 	context->Registry.each([&](entt::entity entity) {
-		DrawEntityNode(entity);
+		if (context->GetParent(entity) == entt::null)
+			roots.push_back(entity);
 	});
+	for (entt::entity entity : roots) {
+		DrawEntityNode(entity);
+	}
+	if (entityToDestroy != entt::null) {
+		context->DestroyEntity(entityToDestroy);
+		entityToDestroy = entt::null;
+	}
 
 	if (ImGui::IsMouseDown(ImGuiMouseButton_Left) && ImGui::IsWindowHovered()) {
 		selectionContext = entt::null;
@@ -92,21 +102,43 @@ void SceneHierarchyPanel::OnImguiRender() {
 
 void SceneHierarchyPanel::DrawEntityNode(entt::entity entity) {
 	auto& tc = context->Registry.get<TagComponent>(entity);
+	auto* relationship = context->Registry.try_get<RelationshipComponent>(entity);
+	bool hasChildren = relationship && !relationship->Children.empty();
 
 	// don't open tree node when click on name, but only on arrow only
 	ImGuiTreeNodeFlags flags = ((selectionContext == entity) ? ImGuiTreeNodeFlags_Selected : 0)
-		| ImGuiTreeNodeFlags_OpenOnArrow;
+		| ImGuiTreeNodeFlags_OpenOnArrow
+		| (hasChildren ? 0 : ImGuiTreeNodeFlags_Leaf);
 	const char* label = tc.Tag.c_str();
-	bool opened = ImGui::TreeNodeEx(label, flags);
+	bool opened = ImGui::TreeNodeEx((void*)(uint64_t)entity, flags, "%s", label);
 	if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
 		selectionContext = entity;
 	}
 
-	bool isEntityDeleted = false;
+	// drag an entity onto another one to make it a child
+	if (ImGui::BeginDragDropSource()) {
+		ImGui::SetDragDropPayload("SCENE_HIERARCHY_ENTITY", &entity, sizeof(entt::entity));
+		ImGui::Text("%s", label);
+		ImGui::EndDragDropSource();
+	}
+	if (ImGui::BeginDragDropTarget()) {
+		if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("SCENE_HIERARCHY_ENTITY")) {
+			context->SetParent(*(const entt::entity*)payload->Data, entity);
+		}
+		ImGui::EndDragDropTarget();
+	}
+
 	if (ImGui::BeginPopupContextItem()) {
+		if (ImGui::MenuItem("Create Child Entity")) {
+			entt::entity child = context->CreateEntity("Unnamed Entity");
+			context->SetParent(child, entity, false);
+		}
+		if (context->GetParent(entity) != entt::null && ImGui::MenuItem("Unparent")) {
+			context->SetParent(entity, entt::null);
+		}
 		if (ImGui::MenuItem("Delete Entity")) {
-			isEntityDeleted = true;
-			if (selectionContext == entity) {
+			entityToDestroy = entity;
+			if (selectionContext == entity || (selectionContext != entt::null && context->IsDescendantOf(selectionContext, entity))) {
 				selectionContext = entt::null;
 			}
 		}
@@ -114,12 +146,15 @@ void SceneHierarchyPanel::DrawEntityNode(entt::entity entity) {
 	}
 
 	if (opened) {
+		// copy, the hierarchy can change while drawing children
+		if (auto* rc = context->Registry.try_get<RelationshipComponent>(entity)) {
+			std::vector<entt::entity> children = rc->Children;
+			for (entt::entity child : children) {
+				DrawEntityNode(child);
+			}
+		}
 		ImGui::TreePop();
 	}
-
-	if (isEntityDeleted) {
-		context->DestroyEntity(entity);
-	}
 }
 
 static void DrawVec3Control(const std::string& label, glm::vec3& values, float resetValue = 0.0f, float columnWidth = 100.0f) {
@@ -277,6 +312,7 @@ void DrawComponentParametersUI(CameraComponent& cameraComponent) {
 
 void DrawComponentParametersUI(LightComponent& lc) {
 	ImGui::DragFloat("Intensity", &lc.intensity);
+	ImGui::DragFloat("Range", &lc.range, 0.1f, 0.0f, 1000.0f);
 }
 
 void DrawComponentParametersUI(LineComponent& lc) {
@@ -285,15 +321,12 @@ void DrawComponentParametersUI(LineComponent& lc) {
 	int ix = 0;
 
 	for (glm::vec3& v : vertices) {
-		if (ImGui::InputFloat3(std::to_string(ix).c_str(), glm::value_ptr(v), "%.3f", treeNodeFlags)) {
-			lc.ComputeVertexArray();
-		}
+		ImGui::InputFloat3(std::to_string(ix).c_str(), glm::value_ptr(v), "%.3f", treeNodeFlags);
 		ix++;
 	}
 	if (ImGui::InputInt("Count", &numVertices, 1, 10, treeNodeFlags)) {
 		if (numVertices >= 2 && numVertices < 100) {
 			vertices.resize(numVertices);
-			lc.ComputeVertexArray();
 		}
 	}
 }
@@ -380,6 +413,10 @@ void DrawComponentParametersUI(MeshComponent& mc) {
 			mc.ComputeVertexArray();
 		}
 	}
+	ImGui::Separator();
+	if (ImGui::Checkbox("Use BSP", &mc.UseBSP)) {
+		mc.ComputeBSPTree();
+	}
 }
 
 void DrawComponentParametersUI(MeshObjLoaderComponent& molc) {
@@ -390,6 +427,17 @@ void DrawComponentParametersUI(MeshObjLoaderComponent& molc) {
 	if (ImGui::InputText("OBJ File Path", buffer, sizeof(buffer), ImGuiInputTextFlags_EnterReturnsTrue)) {
 		molc.SetFilePath(std::string(buffer));
 	}
+	if (ImGui::Checkbox("Use BSP", &molc.meshComponent.UseBSP)) {
+		molc.meshComponent.ComputeBSPTree();
+	}
+}
+
+void DrawComponentParametersUI(MeshLODComponent& lodc) {
+	ImGui::Text("Current LOD: %d", lodc.CurrentLOD);
+	for (size_t i = 0; i < lodc.Levels.size(); i++) {
+		ImGui::Text("LOD %d: %d triangles", (int)i + 1, (int)lodc.Levels[i].Indices.size());
+	}
+	ImGui::SliderInt("Forced LOD", &lodc.ForcedLOD, -1, (int)lodc.Levels.size());
 }
 
 void DrawComponentParametersUI(MeshRendererComponent& mrc) {
@@ -432,11 +480,15 @@ void SceneHierarchyPanel::DrawComponents(entt::entity entity) {
 	if (handle.all_of<TransformComponent>()) {
 		if (ImGui::TreeNodeEx("Transform", treeNodeFlags)) {
 			auto& transform = handle.get<TransformComponent>();
+			const TransformComponent before = transform;
 			DrawVec3Control("Translation", transform.Translation);
 			glm::vec3 rotation = glm::degrees(transform.Rotation);
 			DrawVec3Control("Rotation", rotation);
 			transform.Rotation = glm::radians(rotation);
 			DrawVec3Control("Scale", transform.Scale, 1.0f);
+			if (transform.Translation != before.Translation || transform.Rotation != before.Rotation || transform.Scale != before.Scale) {
+				handle.patch<TransformComponent>();
+			}
 			ImGui::TreePop();
 		}
 	}
@@ -446,7 +498,21 @@ void SceneHierarchyPanel::DrawComponents(entt::entity entity) {
 	DrawComponentUITreeNodeIfExists<LineComponent>(handle, DrawComponentParametersUI);
 	DrawComponentUITreeNodeIfExists<LineGeneratorComponent>(handle, DrawComponentParametersUI);
 	DrawComponentUITreeNodeIfExists<LineRendererComponent>(handle, DrawComponentParametersUI);
-	DrawComponentUITreeNodeIfExists<MeshComponent>(handle, DrawComponentParametersUI);
-	DrawComponentUITreeNodeIfExists<MeshObjLoaderComponent>(handle, DrawComponentParametersUI);
+	// patching edited meshes lets the scene update their bounds
+	if (handle.all_of<MeshComponent>()) {
+		uint32_t version = handle.get<MeshComponent>().version;
+		DrawComponentUITreeNodeIfExists<MeshComponent>(handle, DrawComponentParametersUI);
+		if (handle.all_of<MeshComponent>() && handle.get<MeshComponent>().version != version) {
+			handle.patch<MeshComponent>();
+		}
+	}
+	if (handle.all_of<MeshObjLoaderComponent>()) {
+		uint32_t version = handle.get<MeshObjLoaderComponent>().meshComponent.version;
+		DrawComponentUITreeNodeIfExists<MeshObjLoaderComponent>(handle, DrawComponentParametersUI);
+		if (handle.all_of<MeshObjLoaderComponent>() && handle.get<MeshObjLoaderComponent>().meshComponent.version != version) {
+			handle.patch<MeshObjLoaderComponent>();
+		}
+	}
+	DrawComponentUITreeNodeIfExists<MeshLODComponent>(handle, DrawComponentParametersUI);
 	DrawComponentUITreeNodeIfExists<MeshRendererComponent>(handle, DrawComponentParametersUI);
 }
@@ -23,4 +23,6 @@ private:
 private:
 	std::shared_ptr<Scene> context;
 	entt::entity selectionContext = entt::null;
+	// destroyed after drawing the hierarchy, not while iterating it
+	entt::entity entityToDestroy = entt::null;
 };
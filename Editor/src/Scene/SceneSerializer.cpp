@@ -3,6 +3,7 @@
 #include <iostream>
 #include <fstream>
 #include <type_traits>
+#include <unordered_map>
 
 #include <yaml-cpp/yaml.h>
 
@@ -125,6 +126,7 @@ namespace ComponentSerializer {
 
 	static void serialize(YAML::Emitter& out, LightComponent& comp) {
 		out << YAML::Key << "Intensity" << YAML::Value << comp.intensity;
+		out << YAML::Key << "Range" << YAML::Value << comp.range;
 	}
 
 	static void serialize(YAML::Emitter& out, LineComponent& comp) {
@@ -188,6 +190,12 @@ namespace ComponentSerializer {
 			out << triplet;
 		}
 		out << YAML::EndSeq; // Indices
+		out << YAML::Key << "UseBSP" << YAML::Value << comp.UseBSP;
+	}
+
+	// Children are not written, they are restored from the Parent of each child
+	static void serialize(YAML::Emitter& out, RelationshipComponent& comp) {
+		out << YAML::Key << "Parent" << YAML::Value << (comp.Parent == entt::null ? -1 : (int64_t)comp.Parent);
 	}
 
 	static void serialize(YAML::Emitter& out, MeshRendererComponent& comp) {
@@ -197,6 +205,7 @@ namespace ComponentSerializer {
 
 	static void serialize(YAML::Emitter& out, MeshObjLoaderComponent& comp) {
 		out << YAML::Key << "Filepath" << YAML::Value << comp.filepath;
+		out << YAML::Key << "UseBSP" << YAML::Value << comp.meshComponent.UseBSP;
 	}
 
 	template <typename TComp, typename = std::enable_if_t<std::is_base_of_v<Component, TComp>>>
@@ -234,6 +243,9 @@ namespace ComponentSerializer {
 
 	static void deserialize(YAML::Node node, LightComponent& comp) {
 		comp.intensity = node["Intensity"].as<float>();
+		if (node["Range"]) {
+			comp.range = node["Range"].as<float>();
+		}
 	}
 
 	static void deserialize(YAML::Node node, LineComponent& comp) {
@@ -242,7 +254,6 @@ namespace ComponentSerializer {
 			vertices.push_back(vertex.as<glm::vec3>());
 		}
 		comp.Vertices = vertices;
-		comp.ComputeVertexArray();
 	}
 
 	static void deserialize(YAML::Node node, LineGeneratorComponent& comp) {
@@ -287,6 +298,9 @@ namespace ComponentSerializer {
 		}
 		comp.Vertices = vertices;
 		comp.Indices = indices;
+		if (node["UseBSP"]) {
+			comp.UseBSP = node["UseBSP"].as<bool>();
+		}
 		comp.ComputeVertexArray();
 	}
 
@@ -296,6 +310,9 @@ namespace ComponentSerializer {
 	}
 
 	static void deserialize(YAML::Node node, MeshObjLoaderComponent& comp) {
+		if (node["UseBSP"]) {
+			comp.meshComponent.UseBSP = node["UseBSP"].as<bool>();
+		}
 		comp.SetFilePath(node["Filepath"].as<std::string>());
 	}
 
@@ -312,10 +329,11 @@ namespace ComponentSerializer {
 
 static void SerializeEntity(YAML::Emitter& out, entt::basic_handle<entt::entity> handle) {
 	out << YAML::BeginMap; // Entity
-	out << YAML::Key << "Entity" << YAML::Value << "12837192831273";
+	out << YAML::Key << "Entity" << YAML::Value << (uint32_t)handle.entity(); // only unique within the file
 	
 	ComponentSerializer::serializeIfExists<TagComponent>(out, handle);
 	ComponentSerializer::serializeIfExists<TransformComponent>(out, handle);
+	ComponentSerializer::serializeIfExists<RelationshipComponent>(out, handle);
 	ComponentSerializer::serializeIfExists<CameraComponent>(out, handle);
 	ComponentSerializer::serializeIfExists<LightComponent>(out, handle);
 	ComponentSerializer::serializeIfExists<LineComponent>(out, handle);
@@ -341,6 +359,7 @@ entt::entity SceneSerializer::DeserializeEntity(YAML::Node node) {
 	entt::basic_handle deserializedHandle = entt::basic_handle{ scene->Registry, deserializedEntity };
 
 	ComponentSerializer::deserializeIfExists<TransformComponent>(node, deserializedHandle);
+	deserializedHandle.patch<TransformComponent>(); // so that its matrices are computed before the first render
 	ComponentSerializer::deserializeIfExists<CameraComponent>(node, deserializedHandle);
 	ComponentSerializer::deserializeIfExists<LightComponent>(node, deserializedHandle);
 	ComponentSerializer::deserializeIfExists<LineComponent>(node, deserializedHandle);
@@ -386,8 +405,25 @@ bool SceneSerializer::Deserialize(const std::filesystem::path& filepath) {
 	if (!entities)
 		return false;
 
+	// Parents can come after their children in the file. Link them after all entities are created.
+	std::unordered_map<uint64_t, entt::entity> entityOfId;
+	std::vector<std::pair<entt::entity, uint64_t>> parentIds;
 	for (auto entity : entities) {
-		DeserializeEntity(entity);
+		entt::entity deserializedEntity = DeserializeEntity(entity);
+		entityOfId[entity["Entity"].as<uint64_t>()] = deserializedEntity;
+		auto relationship = entity[RelationshipComponent::GetName()];
+		if (relationship && relationship["Parent"].as<int64_t>() >= 0) {
+			parentIds.push_back({ deserializedEntity, relationship["Parent"].as<uint64_t>() });
+		}
+	}
+	for (auto [child, parentId] : parentIds) {
+		auto it = entityOfId.find(parentId);
+		if (it == entityOfId.end()) {
+			std::cerr << "Parent " << parentId << " of an entity not found in the scene file." << std::endl;
+			continue;
+		}
+		// transforms in the file are already relative to the parent
+		scene->SetParent(child, it->second, false);
 	}
 	
 	return true;
@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool() {
+	// at least one, Enqueue'd background tasks need a worker even on a single core
+	uint32_t numWorkers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	for (uint32_t i = 0; i < numWorkers; i++) {
+		workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::WorkerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return isStopping || !tasks.empty(); });
+			if (isStopping && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t jobCount, const std::function<void(uint32_t jobIndex)>& job) {
+	if (jobCount == 0) return;
+	if (jobCount == 1 || workers.empty()) {
+		for (uint32_t i = 0; i < jobCount; i++)
+			job(i);
+		return;
+	}
+
+	// Shared with helper tasks, which can start after this call has returned. They find no job left then.
+	struct State {
+		std::atomic<uint32_t> nextJob = 0;
+		std::atomic<uint32_t> finishedJobs = 0;
+		const std::function<void(uint32_t)>* job = nullptr;
+		uint32_t jobCount = 0;
+	};
+	auto state = std::make_shared<State>();
+	state->job = &job;
+	state->jobCount = jobCount;
+
+	auto work = [state]() {
+		for (uint32_t i = state->nextJob++; i < state->jobCount; i = state->nextJob++) {
+			(*state->job)(i);
+			state->finishedJobs++;
+		}
+	};
+
+	uint32_t numHelpers = std::min((uint32_t)workers.size(), jobCount - 1);
+	for (uint32_t i = 0; i < numHelpers; i++) {
+		Enqueue(work);
+	}
+	work();
+
+	while (state->finishedJobs < jobCount) {
+		std::this_thread::yield();
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads shared by the systems that split per-frame work (sorting, culling etc.) into jobs.
+class ThreadPool {
+public:
+	static ThreadPool& Instance() { static ThreadPool instance; return instance; }
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	// Number of threads that can work on a ParallelFor at the same time, including the calling thread
+	uint32_t GetThreadCount() const { return (uint32_t)workers.size() + 1; }
+
+	// Calls job(jobIndex) for every jobIndex in [0, jobCount) and returns when all of them are finished.
+	// The calling thread works on the jobs too, hence it is safe to call from inside a task.
+	void ParallelFor(uint32_t jobCount, const std::function<void(uint32_t jobIndex)>& job);
+
+	// Runs the task on a worker thread without waiting for it
+	void Enqueue(std::function<void()> task);
+private:
+	ThreadPool();
+	~ThreadPool();
+	void WorkerLoop();
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool isStopping = false;
+};